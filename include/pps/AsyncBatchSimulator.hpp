@@ -20,6 +20,8 @@
 #pragma once
 
 #include <array>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <tuple>
 #include <type_traits>
@@ -27,13 +29,17 @@
 
 #include <tlx/die.hpp>
 
-#include <pps/CollisionDistribution.hpp>
+#include <pps/CollisionScheduler.hpp>
 #include <pps/EpochLengthController.hpp>
 #include <pps/FairCoin.hpp>
 #include <pps/Protocols.hpp>
 #include <pps/ScopedTimer.h>
+#include <pps/SkipMasks.hpp>
+#include <pps/ThreadPool.hpp>
+#include <sampling/multivariate_hypergeometric.hpp>
 
 #include "WeightedUrn.hpp"
+#include <urns/Traits.hpp>
 #include <urns/TreeUrn.hpp>
 
 namespace pps {
@@ -45,30 +51,80 @@ public:
 
     AsyncBatchSimulator() = delete;
 
-    AsyncBatchSimulator(const urn_type &urn, Protocol p, RandGen &gen)
+    /**
+     * If num_threads > 1, the delayed agents of each epoch are processed by a pool
+     * of num_threads threads. This is only supported for deterministic protocols;
+     * other protocols silently fall back to the sequential implementation.
+     *
+     * If pipelined_schedule is set, the run lengths and collisions of upcoming epochs
+     * are computed by a helper thread while the urns are updated (see CollisionScheduler).
+     */
+    AsyncBatchSimulator(const urn_type &urn, Protocol p, RandGen &gen, unsigned num_threads = 1,
+                        bool pipelined_schedule = false)
         : agents_(urn.number_of_colors()), updated_agents_(agents_.number_of_colors()),
           target_epoch_length_(urn.number_of_balls()),
 
-          protocol_(std::move(p)), prng_(gen),
-          collision_distr_(urn.number_of_balls(), 0, 2 * target_epoch_length_.max()) {
+          protocol_(std::move(p)), prng_(gen) {
         die_verbose_unless(urn.number_of_balls() > 0, "Provided empty urn to simulator");
         agents_.add_urn(urn);
 
+        // untouched agents are drawn one by one from the urn updated once per epoch
+        if constexpr (std::is_same_v<urn_type, WeightedUrn>)
+            agents_.enable_guide_table();
+
         if constexpr (Protocols::is_deterministic<Protocol>) {
             if constexpr (Protocols::is_one_way<Protocol>) {
                 one_way_partitions_ =
                     Protocols::parition_oneway_transactions(protocol_, agents_.number_of_colors());
 
             } else {
-                size_t skips;
-                std::tie(skipable_transactions_, skips) =
+                const auto [skip_lists, skips] =
                     Protocols::transactions_without_change(protocol_, agents_.number_of_colors());
                 use_skip_heuristic_ = (skips > agents_.number_of_colors());
+                if (use_skip_heuristic_)
+                    skip_masks_ = SkipMasks(skip_lists);
 
                 // std::cout << "Skip Transactions: " << use_skip_heuristic_ << '\n';
+
+                // group partners with identical outcomes; we only use the partitions if they
+                // substantially reduce the number of hypergeometric variates per first agent
+                two_way_partitions_ = Protocols::parition_twoway_transactions(
+                    protocol_, agents_.number_of_colors(), use_skip_heuristic_);
+
+                const auto num_colors = agents_.number_of_colors();
+                const auto num_transitions =
+                    num_colors * num_colors - (use_skip_heuristic_ ? skips : 0);
+                const auto num_partitions = std::accumulate(
+                    two_way_partitions_.cbegin(), two_way_partitions_.cend(), size_t{0},
+                    [](size_t s, const auto &row) { return s + row.size(); });
+
+                use_two_way_partitions_ = (4 * num_partitions < 3 * num_transitions);
+                if (!use_two_way_partitions_)
+                    two_way_partitions_.clear();
             }
+        }
+
+        if (Protocols::is_deterministic<Protocol> && num_threads > 1) {
+            thread_pool_ = std::make_unique<ThreadPool>(num_threads);
+
+            // we use more groups than threads to compensate for imbalanced tasks
+            const auto num_workers = 4 * num_threads;
+            workers_.reserve(num_workers);
+            for (unsigned i = 0; i < num_workers; ++i)
+                workers_.push_back(Worker{std::mt19937_64{prng_()},
+                                          urn_type(agents_.number_of_colors()),
+                                          urn_type(agents_.number_of_colors()),
+                                          urn_type(agents_.number_of_colors())});
+        }
+
+        // only one of both schedulers is used; each tabulates the collision distribution
+        if (pipelined_schedule) {
+            async_scheduler_ = std::make_unique<AsyncCollisionScheduler>(
+                urn.number_of_balls(), 2 * target_epoch_length_.max(),
+                target_epoch_length_.current_best(), prng_());
         } else {
-            skipable_transactions_.resize(agents_.number_of_colors());
+            scheduler_ = std::make_unique<CollisionScheduler>(urn.number_of_balls(),
+                                                              2 * target_epoch_length_.max());
         }
     }
 
@@ -119,15 +175,32 @@ private:
     RandGen &prng_;
     FairCoin fair_coin_;
 
-    CollisionDisitribution collision_distr_;
+    std::unique_ptr<CollisionScheduler> scheduler_;
+    std::unique_ptr<AsyncCollisionScheduler> async_scheduler_;
 
-    std::vector<std::pair<state_t, count_t>>
-        first_agents_; //! buffer for process_delayed_agents to avoid reallocation
+    using task_type = std::pair<state_t, count_t>;
+    using task_iterator = typename std::vector<task_type>::const_iterator;
 
-    std::vector<std::vector<state_t>> skipable_transactions_;
+    //! buffer for process_delayed_agents to avoid reallocation
+    std::vector<task_type> first_agents_;
+
+    SkipMasks skip_masks_;
     bool use_skip_heuristic_{false};
 
     Protocols::OneWayPartitions one_way_partitions_;
+    Protocols::TwoWayPartitions two_way_partitions_;
+    bool use_two_way_partitions_{false};
+
+    // parallel processing of delayed agents (only used if num_threads > 1)
+    struct Worker {
+        std::mt19937_64 prng;
+        urn_type partners;       //! agents available as second partners to this worker
+        urn_type skipped;        //! partners left unchanged by the skip heuristic
+        urn_type updated_agents; //! private counterpart of updated_agents_
+    };
+
+    std::unique_ptr<ThreadPool> thread_pool_;
+    std::vector<Worker> workers_;
 
     // state
     size_t num_interactions_{0};
@@ -135,174 +208,292 @@ private:
     size_t num_epochs_{0};
 
     void sample_run_lengths_and_plant_collisions() {
-        const auto num_agents = agents_.number_of_balls() + updated_agents_.number_of_balls();
-
-        while (num_delayed_agents_ + updated_agents_.number_of_balls()
-               < target_epoch_length_.current()) {
-            // sample length of next round
-            auto num_colliding_agents = num_delayed_agents_ + updated_agents_.number_of_balls();
-            collision_distr_.set_red(num_colliding_agents);
-            size_t round_length;
-            do {
-                round_length = collision_distr_(prng_);
-            } while (!num_colliding_agents && round_length < 2);
-            num_delayed_agents_ += 2 * (round_length / 2);
-
-            // helper to sample agents
-            num_colliding_agents = num_delayed_agents_ + updated_agents_.number_of_balls();
-            auto sample_agent = [&](bool has_collision) {
-                if (has_collision) {
-                    if (with_probability_(num_delayed_agents_, num_colliding_agents))
-                        return sample_delayed_agent();
-
-                    return sample_updated_agent();
-                }
+        if (async_scheduler_) {
+            async_scheduler_->set_target_epoch_length(target_epoch_length_.current());
+            while (auto run = async_scheduler_->next())
+                plant_collision(*run);
 
-                return sample_untouched_agent();
-            };
+        } else {
+            scheduler_->start_epoch(target_epoch_length_.current());
+            while (auto run = scheduler_->next(prng_))
+                plant_collision(*run);
+        }
+    }
+
+    void plant_collision(const ScheduledRun &run) {
+        num_delayed_agents_ += run.new_delayed_agents;
+
+        auto first = sample_agent(run.first);
+        auto second = sample_agent(run.second);
 
-            // plant collision
-            const auto has_collision_on_first = (round_length % 2 == 0);
-            const auto has_collision_on_second =
-                !has_collision_on_first || with_probability_(num_colliding_agents, num_agents);
-            auto first = sample_agent(has_collision_on_first);
-            auto second = sample_agent(has_collision_on_second);
+        std::tie(first, second) = perform_interaction(first, second);
 
-            std::tie(first, second) = perform_interaction(first, second);
+        updated_agents_.add_balls(first, 1);
+        updated_agents_.add_balls(second, 1);
 
-            updated_agents_.add_balls(first, 1);
-            updated_agents_.add_balls(second, 1);
+        num_runs_++;
+        assert(num_delayed_agents_ % 2 == 0);
+    }
 
-            num_runs_++;
-            assert(num_delayed_agents_ % 2 == 0);
+    state_t sample_agent(AgentSource source) {
+        switch (source) {
+        case AgentSource::Delayed:
+            return sample_delayed_agent();
+        case AgentSource::Updated:
+            return sample_updated_agent();
+        default:
+            return sample_untouched_agent();
         }
     }
 
     void process_delayed_agents() {
-        if (Protocols::is_deterministic<Protocol> && Protocols::is_one_way<Protocol>)
-            return process_delayed_agents_partitioned();
-
         assert(first_agents_.empty());
-        const auto num_agents = agents_.number_of_balls() + updated_agents_.number_of_balls();
 
         agents_.template remove_random_balls<false>(
             num_delayed_agents_ / 2, prng_,
             [&](auto col, auto num) { first_agents_.emplace_back(col, num); });
 
-        sampling::hypergeometric_distribution<RandGen, size_t> hpd(prng_);
-
-        for (const auto task : first_agents_) {
-            const auto first_state = task.first;
-            const auto &skips = skipable_transactions_[first_state];
-            auto left_to_sample = task.second;
-            auto unconsidered_balls = static_cast<double>(agents_.number_of_balls());
-
-            const auto number_of_skipable_balls =
-                !use_skip_heuristic_
-                    ? 0
-                    : std::accumulate(skips.begin(), skips.end(), 0llu, [&](size_t sum, state_t x) {
-                          return sum + agents_.number_of_balls_with_color(x);
-                      });
-
-            // first exclude skipped balls
-            if (number_of_skipable_balls) {
-                unconsidered_balls -= number_of_skipable_balls;
-                const auto skipped_trans =
-                    hpd(number_of_skipable_balls, unconsidered_balls, left_to_sample);
-                left_to_sample -= skipped_trans;
-                updated_agents_.add_balls(first_state, skipped_trans);
+        if (thread_pool_ && first_agents_.size() > 1) {
+            process_tasks_in_parallel();
+        } else {
+            process_tasks(first_agents_.cbegin(), first_agents_.cend(), agents_, prng_,
+                          updated_agents_);
+        }
+
+        num_interactions_ += num_delayed_agents_ / 2;
+
+        first_agents_.clear();
+    }
+
+    /**
+     * Each worker obtains a contiguous range of first_agents_.
+     *
+     * One-way protocols leave the partners unchanged. As in the sequential variant, every
+     * task then samples its partners from all of agents_, which the workers only read.
+     *
+     * Otherwise, each worker obtains a private pool of partners which we draw sequentially
+     * from agents_ (i.e., a conditional multivariate hypergeometric split of the partners
+     * among the workers), and each task takes its partners uniformly from what is left of
+     * the pool. Partners excluded by the skip heuristic do not change; they are moved out
+     * of the pool into worker.skipped and return to agents_ at the end of the epoch. Hence
+     * they are not over-represented for later tasks of the group; contrary to the
+     * sequential variant, they are however not available to any later task of the epoch.
+     */
+    void process_tasks_in_parallel() {
+        const auto num_groups = std::min(workers_.size(), first_agents_.size());
+        auto group_begin = [&](size_t g) {
+            return first_agents_.cbegin() + (first_agents_.size() * g / num_groups);
+        };
+
+        constexpr bool shared_partners =
+            Protocols::is_deterministic<Protocol> && Protocols::is_one_way<Protocol>;
+
+        if constexpr (!shared_partners) {
+            for (size_t g = 0; g < num_groups; ++g) {
+                const auto num_partners = std::accumulate(
+                    group_begin(g), group_begin(g + 1), count_t{0},
+                    [](count_t sum, const auto &task) { return sum + task.second; });
+
+                auto &partners = workers_[g].partners;
+                agents_.template remove_random_balls<false>(
+                    num_partners, prng_, [&](auto col, auto num) { partners.add_balls(col, num); });
+            }
+        }
+
+        thread_pool_->run([&](unsigned g) {
+            for (; g < num_groups; g += thread_pool_->num_threads()) {
+                auto &worker = workers_[g];
+                if constexpr (shared_partners) {
+                    process_tasks_partitioned(group_begin(g), group_begin(g + 1), agents_,
+                                              worker.prng, worker.updated_agents);
+                } else {
+                    process_tasks(group_begin(g), group_begin(g + 1), worker.partners,
+                                  worker.prng, worker.updated_agents, &worker.skipped);
+                }
             }
+        });
 
-            auto skips_iter = skips.cbegin();
-            for (state_t second = 0; left_to_sample; ++second) {
-                assert(second < agents_.number_of_colors());
+        for (size_t g = 0; g < num_groups; ++g) {
+            auto &worker = workers_[g];
 
-                if (use_skip_heuristic_) {
-                    while (skips_iter != skips.cend() && *skips_iter < second) {
-                        skips_iter++;
-                    }
+            updated_agents_.add_urn(worker.updated_agents);
+            worker.updated_agents.clear();
 
-                    if (skips_iter != skips.cend() && *skips_iter == second)
-                        continue;
+            for (auto *unchanged : {&worker.partners, &worker.skipped}) {
+                if (!unchanged->empty()) {
+                    agents_.add_urn(*unchanged);
+                    unchanged->clear();
                 }
+            }
+        }
+    }
+
+    // match every first agent in [begin, end) with a partner drawn from partners; if skipped
+    // is given, partners excluded by the skip heuristic are moved from partners into it
+    template <typename Gen>
+    void process_tasks(task_iterator begin, task_iterator end, urn_type &partners, Gen &gen,
+                       urn_type &target, urn_type *skipped = nullptr) {
+        if constexpr (Protocols::is_deterministic<Protocol> && Protocols::is_one_way<Protocol>) {
+            process_tasks_partitioned(begin, end, partners, gen, target);
+        } else if (use_two_way_partitions_) {
+            process_tasks_partitioned_twoway(begin, end, partners, gen, target, skipped);
+        } else {
+            process_tasks_pairwise(begin, end, partners, gen, target, skipped);
+        }
+    }
 
-                const auto balls_with_color = agents_.number_of_balls_with_color(second);
-                unconsidered_balls -= balls_with_color;
-                const auto num_selected = [&]() -> size_t {
-                    if (!balls_with_color)
-                        return 0;
+    // decide how many partners of the first agents do not result in a state change; all
+    // skippable partners are treated as the first cell of the split
+    template <typename Split, typename Mvh>
+    void sample_skipped_partners(state_t first_state, Split &split, urn_type &partners,
+                                 urn_type &target, urn_type *skipped, Mvh &mvh) {
+        if (!use_skip_heuristic_)
+            return;
 
-                    if (!unconsidered_balls)
-                        return std::min(left_to_sample, balls_with_color);
+        const auto number_of_skipable_balls = skip_masks_.masked_sum(first_state, partners.data());
 
-                    return hpd(balls_with_color, unconsidered_balls, left_to_sample);
-                }();
+        // first exclude skipped balls
+        if (!number_of_skipable_balls)
+            return;
 
-                if (num_selected) {
-                    agents_.remove_balls(second, num_selected);
-                    perform_interactions(first_state, second, num_selected, updated_agents_);
+        const auto skipped_trans = split(number_of_skipable_balls);
+        target.add_balls(first_state, skipped_trans);
+
+        if (!skipped || !skipped_trans)
+            return;
+
+        // decide which of the skippable partners were selected
+        auto skip_split = mvh.start(number_of_skipable_balls, skipped_trans);
+        skip_masks_.for_each(first_state, [&](state_t second) {
+            if (!skip_split.left_to_sample())
+                return;
+
+            const auto num_selected = skip_split(partners.number_of_balls_with_color(second));
+            if (num_selected) {
+                partners.remove_balls(second, num_selected);
+                skipped->add_balls(second, num_selected);
+            }
+        });
+    }
+
+    template <typename Gen>
+    void process_tasks_pairwise(task_iterator begin, task_iterator end, urn_type &partners,
+                                Gen &gen, urn_type &target, urn_type *skipped) {
+        sampling::multivariate_hypergeometric<Gen, count_t> mvh(gen);
+
+        for (auto it = begin; it != end; ++it) {
+            const auto first_state = it->first;
+            auto split = mvh.start(partners.number_of_balls(), it->second);
+            sample_skipped_partners(first_state, split, partners, target, skipped, mvh);
+
+            // smallest candidate partner state >= state; if the urn keeps an index of its
+            // occupied states and most of them are empty, we skip the empty ones
+            bool skip_empty = false;
+            if constexpr (urns::traits::has_occupied_colors_v<urn_type>)
+                skip_empty = 4 * partners.occupied_colors().size() < partners.number_of_colors();
+
+            auto candidate = [&](state_t state) -> state_t {
+                if constexpr (urns::traits::has_occupied_colors_v<urn_type>) {
+                    if (skip_empty)
+                        return static_cast<state_t>(partners.occupied_colors().find_next(state));
                 }
+                return state;
+            };
+
+            for (state_t second = candidate(0); split.left_to_sample();
+                 second = candidate(second + 1)) {
+                assert(second < partners.number_of_colors());
+
+                if (use_skip_heuristic_ && skip_masks_.test(first_state, second))
+                    continue;
 
-                left_to_sample -= num_selected;
+                const auto num_selected = split(partners.number_of_balls_with_color(second));
+                if (num_selected) {
+                    partners.remove_balls(second, num_selected);
+                    perform_interactions(first_state, second, num_selected, target);
+                }
             }
         }
-
-        first_agents_.clear();
     }
 
-    void process_delayed_agents_partitioned() {
-        assert(first_agents_.empty());
-        const auto num_agents = agents_.number_of_balls() + updated_agents_.number_of_balls();
+    template <typename Gen>
+    void process_tasks_partitioned_twoway(task_iterator begin, task_iterator end,
+                                          urn_type &partners, Gen &gen, urn_type &target,
+                                          urn_type *skipped) {
+        sampling::multivariate_hypergeometric<Gen, count_t> mvh(gen);
 
-        agents_.template remove_random_balls<false>(
-            num_delayed_agents_ / 2, prng_,
-            [&](auto col, auto num) { first_agents_.emplace_back(col, num); });
+        for (auto it = begin; it != end; ++it) {
+            const auto first_state = it->first;
+            auto split = mvh.start(partners.number_of_balls(), it->second);
+            sample_skipped_partners(first_state, split, partners, target, skipped, mvh);
+
+            for (const auto &partition : two_way_partitions_[first_state]) {
+                if (!split.left_to_sample())
+                    break;
+
+                count_t balls_in_partition = 0;
+                for (state_t x : partition.first)
+                    balls_in_partition += partners.number_of_balls_with_color(x);
 
-        sampling::hypergeometric_distribution<RandGen, size_t> hpd(prng_);
+                const auto num_selected = split(balls_in_partition);
+                if (!num_selected)
+                    continue;
 
-        for (const auto task : first_agents_) {
-            const auto first_state = task.first;
-            const auto &skips = skipable_transactions_[first_state];
-            auto left_to_sample = task.second;
-            auto unconsidered_balls = static_cast<double>(agents_.number_of_balls());
+                target.add_balls(partition.second.first, num_selected);
+                target.add_balls(partition.second.second, num_selected);
+                remove_partners(partition.first, balls_in_partition, num_selected, partners, mvh);
+            }
+        }
+    }
+
+    // removes num partners uniformly from the balls with one of the given states
+    template <typename Mvh>
+    void remove_partners(const std::vector<state_t> &states, count_t balls_in_states, count_t num,
+                         urn_type &partners, Mvh &mvh) {
+        if (states.size() == 1)
+            return partners.remove_balls(states.front(), num);
+
+        auto split = mvh.start(balls_in_states, num);
+        for (state_t state : states) {
+            const auto num_selected = split(partners.number_of_balls_with_color(state));
+            if (num_selected)
+                partners.remove_balls(state, num_selected);
+
+            if (!split.left_to_sample())
+                break;
+        }
+    }
+
+    template <typename Gen>
+    void process_tasks_partitioned(task_iterator begin, task_iterator end,
+                                   const urn_type &partners, Gen &gen, urn_type &target) {
+        sampling::multivariate_hypergeometric<Gen, count_t> mvh(gen);
+
+        for (auto it = begin; it != end; ++it) {
+            const auto first_state = it->first;
+            const auto left_to_sample = it->second;
 
             if (TLX_UNLIKELY(!left_to_sample))
                 continue;
 
             if (TLX_UNLIKELY(one_way_partitions_[first_state].size() == 1)) {
                 // only one partition -> whole row goes into new state
-                updated_agents_.add_balls(one_way_partitions_[first_state].front().second,
-                                          left_to_sample);
+                target.add_balls(one_way_partitions_[first_state].front().second, left_to_sample);
                 continue;
             }
 
-            for (const auto partition : one_way_partitions_[first_state]) {
+            auto split = mvh.start(partners.number_of_balls(), left_to_sample);
+            for (const auto &partition : one_way_partitions_[first_state]) {
                 count_t balls_in_second_state = 0;
                 for (state_t x : partition.first)
-                    balls_in_second_state += agents_.number_of_balls_with_color(x);
-
-                unconsidered_balls -= balls_in_second_state;
-                const auto num_selected = [&]() -> count_t {
-                    if (!balls_in_second_state)
-                        return 0;
-
-                    if (!unconsidered_balls)
-                        return std::min(left_to_sample, balls_in_second_state);
+                    balls_in_second_state += partners.number_of_balls_with_color(x);
 
-                    return hpd(balls_in_second_state, unconsidered_balls, left_to_sample);
-                }();
+                target.add_balls(partition.second, split(balls_in_second_state));
 
-                updated_agents_.add_balls(partition.second, num_selected);
-                left_to_sample -= num_selected;
-
-                if (!left_to_sample)
+                if (!split.left_to_sample())
                     break;
             }
         }
-
-        num_interactions_ += num_delayed_agents_ / 2;
-
-        first_agents_.clear();
     }
 
     state_t sample_untouched_agent() { return agents_.remove_random_ball(prng_); }
@@ -311,8 +502,16 @@ private:
         assert(num_delayed_agents_ >= 2);
 
         // obtain agents
-        auto first = sample_untouched_agent();
-        auto second = sample_untouched_agent();
+        state_t first, second;
+        if constexpr (urns::traits::has_batched_draws_v<urn_type>) {
+            std::array<typename urn_type::color_type, 2> agents;
+            agents_.remove_random_balls(prng_, agents.data(), 2);
+            first = static_cast<state_t>(agents[0]);
+            second = static_cast<state_t>(agents[1]);
+        } else {
+            first = sample_untouched_agent();
+            second = sample_untouched_agent();
+        }
         num_delayed_agents_ -= 2;
 
         // execute transition
@@ -328,10 +527,6 @@ private:
 
     state_t sample_updated_agent() { return updated_agents_.remove_random_ball(prng_); }
 
-    bool with_probability_(count_t good, count_t total) {
-        return std::uniform_int_distribution<count_t>{1, total}(prng_) <= good;
-    }
-
     // interaction with protocol
     state_pair_t perform_interaction(state_t first, state_t second) {
         const auto res = Protocols::transition(protocol_, {first, second});
@@ -339,13 +534,13 @@ private:
         return res;
     }
 
-    // carry out a multiple interactions and return update states in urn
+    // carry out a multiple interactions and return update states in urn;
+    // the caller is responsible for updating num_interactions_
     void perform_interactions(state_t first, state_t second, count_t num, urn_type &target) {
         if constexpr (Protocols::is_deterministic<Protocol>) {
             const auto new_states = Protocols::transition(protocol_, {first, second});
             target.add_balls(new_states.first, num);
             target.add_balls(new_states.second, num);
-            num_interactions_ += num;
 
         } else {
             const auto num_agents = target.number_of_balls();
@@ -356,8 +551,6 @@ private:
 
             protocol_(first, second, num, assign_callback);
 
-            num_interactions_ += num;
-
             die_verbose_unless(
                 target.number_of_balls() == num_agents + 2 * num,
                 "The number of updated states assigned does not match the number of interactions");
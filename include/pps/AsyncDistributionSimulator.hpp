@@ -28,10 +28,12 @@
 #include <tlx/die.hpp>
 
 #include <pps/CollisionDistribution.hpp>
+#include <pps/CompiledProtocol.hpp>
 #include <pps/EpochLengthController.hpp>
 #include <pps/FairCoin.hpp>
 #include <pps/Protocols.hpp>
 #include <pps/ScopedTimer.h>
+#include <urns/Traits.hpp>
 
 namespace pps {
 
@@ -43,7 +45,8 @@ public:
     AsyncDistributionSimulator() = delete;
 
     AsyncDistributionSimulator(urn_type urn, Protocol p, RandGen &gen)
-        : agents_(std::move(urn)), protocol_(std::move(p)), prng_(gen),
+        : agents_(std::move(urn)), protocol_(std::move(p)),
+          compiled_protocol_(Protocols::compile(protocol_, agents_.number_of_colors())), prng_(gen),
           epoch_length_(static_cast<size_t>(std::pow(agents_.number_of_balls(), 0.5)) + 1) {
         die_verbose_unless(urn.number_of_balls() > 1, "Need at least two agents");
     }
@@ -53,9 +56,12 @@ public:
         do {
             // we still use the concept of epochs in order to keep the load on monitor
             // roughly comparable to the batch simulator
-            for (size_t intraepoch = 0; intraepoch < epoch_length_; ++intraepoch) {
-                perform_single_interaction();
-            }
+            // use the tabulated protocol if it is small enough
+            Protocols::visit_compiled(protocol_, compiled_protocol_, [&](auto &transition) {
+                for (size_t intraepoch = 0; intraepoch < epoch_length_; ++intraepoch) {
+                    perform_single_interaction(transition);
+                }
+            });
 
             num_interactions_ += epoch_length_;
             ++num_epochs_;
@@ -82,6 +88,7 @@ private:
     urn_type agents_;
 
     Protocol protocol_;
+    Protocols::CompiledVariant<Protocol> compiled_protocol_;
     RandGen &prng_;
     size_t epoch_length_;
 
@@ -90,21 +97,42 @@ private:
     size_t num_runs_{0};
     size_t num_epochs_{0};
 
-    void perform_single_interaction() {
+    template <typename Transition>
+    void perform_single_interaction(Transition &transition) {
+        if constexpr (urns::traits::has_pair_replacement_v<urn_type>) {
+            // the urn draws both agents at once and only applies the changes of their states;
+            // a one-way transition keeps the second state, so that ball is never touched
+            agents_.replace_random_pair(prng_, [&](auto first, auto second) {
+                const auto states =
+                    state_pair_t{static_cast<state_t>(first), static_cast<state_t>(second)};
+                return Protocols::transition(transition, states);
+            });
+            return;
+        }
+
         state_pair_t old_states;
 
-        // first agent is remove (as it may change)
-        old_states.first = agents_.remove_random_ball(prng_);
+        if constexpr (!Protocols::is_one_way<Protocol> &&
+                      urns::traits::has_batched_draws_v<urn_type>) {
+            // both agents are removed; walking the urn for both at once overlaps their misses
+            std::array<typename urn_type::color_type, 2> agents;
+            agents_.remove_random_balls(prng_, agents.data(), 2);
+            old_states = {static_cast<state_t>(agents[0]), static_cast<state_t>(agents[1])};
 
-        // in one-way communication the second agent won't change,
-        // so we just draw a ball, but do not remove it
-        if constexpr (Protocols::is_one_way<Protocol>) {
-            old_states.second = agents_.get_random_ball(prng_);
         } else {
-            old_states.second = agents_.remove_random_ball(prng_);
+            // first agent is remove (as it may change)
+            old_states.first = agents_.remove_random_ball(prng_);
+
+            // in one-way communication the second agent won't change,
+            // so we just draw a ball, but do not remove it
+            if constexpr (Protocols::is_one_way<Protocol>) {
+                old_states.second = agents_.get_random_ball(prng_);
+            } else {
+                old_states.second = agents_.remove_random_ball(prng_);
+            }
         }
 
-        const auto new_states = Protocols::transition(protocol_, old_states);
+        const auto new_states = Protocols::transition(transition, old_states);
         agents_.add_balls(new_states.first);
 
         if constexpr (!Protocols::is_one_way<Protocol>) {
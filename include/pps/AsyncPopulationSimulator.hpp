@@ -21,69 +21,123 @@
 
 #include <algorithm>
 #include <array>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <random>
 #include <tuple>
 #include <utility>
+#include <vector>
 
-#include <tlx/container/ring_buffer.hpp>
 #include <tlx/die.hpp>
+#include <tlx/math.hpp>
 #include <tlx/meta.hpp>
 
+#include <pps/CompiledProtocol.hpp>
+#include <pps/EpochLengthController.hpp>
+#include <pps/PackedPopulation.hpp>
 #include <pps/Protocols.hpp>
+#include <pps/SimdInteractionKernel.hpp>
+#include <pps/ThreadPool.hpp>
 #include <pps/WeightedUrn.hpp>
+#include <urns/BoundedUniform.hpp>
 
 namespace pps {
 
-template <size_t PrefetchInteractions, typename Protocol, typename RandGen>
+/// Pass as PrefetchInteractions to calibrate the prefetch distance at runtime
+constexpr size_t kAdaptivePrefetch = std::numeric_limits<size_t>::max();
+
+/**
+ * Simulates each agent explicitly. The states are stored with BitsPerState bits per
+ * agent (see PackedPopulation); use bits_per_state(num_states) to obtain the most compact
+ * representation.
+ *
+ * For PrefetchInteractions > 0, the agents are drawn in small batches into a ring buffer
+ * and their states are prefetched PrefetchInteractions interactions ahead. With
+ * kAdaptivePrefetch, the distance is chosen between 1 and kMaxPrefetchDistance by an
+ * EpochLengthController that measures the throughput.
+ * If PPS_SIMD_INTERACTIONS is defined, AVX-512 (F and CD) is available, and BitsPerState
+ * is at least 8, interactions of tabulated protocols are carried out in groups by
+ * simd_interactions.
+ *
+ * If num_threads > 1 (only supported for deterministic protocols), the interactions are
+ * drawn in blocks: we take the longest prefix of pairs in which no agent occurs twice,
+ * carry out these independent interactions concurrently, and continue with the pair
+ * causing the first conflict. Since the interactions within a block commute, this
+ * yields the same distribution as the sequential simulation.
+ */
+template <size_t PrefetchInteractions, typename Protocol, typename RandGen,
+          unsigned BitsPerState = 32>
 class AsyncPopulationSimulator {
 public:
-    constexpr static auto kPrefetchInteractions = PrefetchInteractions;
+    constexpr static bool kAdaptive = (PrefetchInteractions == kAdaptivePrefetch);
+    constexpr static size_t kMaxPrefetchDistance = 64;
+    constexpr static size_t kPrefetchInteractions =
+        kAdaptive ? kMaxPrefetchDistance : PrefetchInteractions;
     using urn_type = pps::WeightedUrn;
+    using population_type = PackedPopulation<BitsPerState>;
 
     AsyncPopulationSimulator() = delete;
 
-    AsyncPopulationSimulator(urn_type urn, Protocol p, RandGen &gen)
-        : population_(urn.number_of_balls(), 0), num_states_(urn.number_of_colors()),
-          protocol_(std::move(p)), prng_(gen), agent_distr_(0, urn.number_of_balls() - 1),
+    AsyncPopulationSimulator(urn_type urn, Protocol p, RandGen &gen, unsigned num_threads = 1)
+        : population_(urn.number_of_balls()), num_states_(urn.number_of_colors()),
+          protocol_(std::move(p)), compiled_protocol_(Protocols::compile(protocol_, num_states_)),
+          prng_(gen), agent_distr_(0, urn.number_of_balls() - 1),
           epoch_length_(std::max(kPrefetchInteractions,
                                  static_cast<size_t>(std::pow(urn.number_of_balls(), 0.5)) + 1)),
-          prefetch_buffer_(2 * kPrefetchInteractions) {
+          prefetch_distance_(kPrefetchInteractions),
+          prefetch_controller_(1, kMaxPrefetchDistance) {
         die_verbose_unless(urn.number_of_balls() > 1, "Need at least two agents");
+        die_verbose_unless(bits_per_state(num_states_) <= BitsPerState,
+                           "Cannot represent " << num_states_ << " states with " << BitsPerState
+                                               << " bits");
 
         // copy distribution to population
-        auto it = population_.begin();
+        size_t begin = 0;
         for (pps::state_t s = 0; s < urn.number_of_colors(); ++s) {
             const auto n = urn.number_of_balls_with_color(s);
-            std::fill_n(it, n, s);
-            it += n;
+            population_.fill(begin, n, s);
+            begin += n;
+        }
+
+        if (Protocols::is_deterministic<Protocol> && num_threads > 1) {
+            thread_pool_ = std::make_unique<ThreadPool>(num_threads);
+            block_.reserve(epoch_length_);
+
+            // a block contains at most 2 * epoch_length_ agents; keep the load below 1/2
+            seen_agents_.assign(tlx::round_up_to_power_of_two(4 * epoch_length_), kNoAgent);
+            seen_shift_ = 64 - tlx::integer_log2_floor(seen_agents_.size());
+            used_slots_.reserve(2 * epoch_length_);
+        } else if (kPrefetchInteractions) {
+            // vectorized kernels may request up to kGenerateBatch pairs at once
+            prefetch_ring_.resize(
+                tlx::round_up_to_power_of_two(kPrefetchInteractions + 2 * kGenerateBatch));
+        }
+
+        if (kAdaptive) {
+            prefetch_controller_.start();
+            prefetch_distance_ = prefetch_controller_.current();
         }
     }
 
     template <typename Monitor>
     void run(Monitor &&monitor) {
         do {
-            if constexpr (kPrefetchInteractions == 0) {
-                // we still use the concept of epochs in order to keep the load on monitor
-                // roughly comparable to the batch simulator
-                for (size_t intraepoch = 0; intraepoch < epoch_length_; ++intraepoch) {
-                    perform_single_interaction_with_prefetch();
-                }
-            } else {
-                for (size_t prefetch = 0; prefetch < kPrefetchInteractions; ++prefetch)
-                    prefetch_pair();
-
-                for (size_t intraepoch = 0; intraepoch < epoch_length_ - kPrefetchInteractions;
-                     ++intraepoch) {
-                    perform_prefetched_pair();
-                    prefetch_pair();
-                }
-
-                for (size_t postperform = 0; postperform < kPrefetchInteractions; ++postperform)
-                    perform_prefetched_pair();
-            }
+            // use the tabulated protocol if it is small enough
+            Protocols::visit_compiled(protocol_, compiled_protocol_, [&](auto &transition) {
+                if (thread_pool_)
+                    run_epoch_parallel(transition);
+                else
+                    run_epoch(transition);
+            });
 
             num_interactions_ += epoch_length_;
             ++num_epochs_;
+
+            if constexpr (kAdaptive) {
+                prefetch_controller_.update(num_interactions_);
+                prefetch_distance_ = prefetch_controller_.current();
+            }
         } while (monitor(*this));
     }
 
@@ -99,84 +153,232 @@ public:
 
     size_t target_epoch_length() const noexcept { return epoch_length_; }
 
+    size_t prefetch_distance() const noexcept { return prefetch_distance_; }
+
     RandGen &prng() { return prng_; }
 
-    const std::vector<pps::state_t> &population() const noexcept { return population_; }
+    const population_type &population() const noexcept { return population_; }
 
     // for compat only. EXPENSIVE
     urn_type agents() const {
         urn_type agents(num_states_);
-        for (pps::state_t x : population_) {
-            agents.add_balls(x);
-        }
+        population_.for_each([&](pps::state_t x) { agents.add_balls(x); });
 
         return agents;
     }
 
 private:
-    std::vector<pps::state_t> population_;
+    population_type population_;
     pps::state_t num_states_;
 
     Protocol protocol_;
+    Protocols::CompiledVariant<Protocol> compiled_protocol_;
     RandGen &prng_;
-    std::uniform_int_distribution<size_t> agent_distr_;
+    urns::UniformInt<size_t> agent_distr_;
     size_t epoch_length_;
 
-    tlx::RingBuffer<pps::state_t *> prefetch_buffer_;
+    using agent_pair_t = std::pair<size_t, size_t>;
+
+    static constexpr size_t kGenerateBatch = 8; //!< number of pairs drawn in one go
+
+    std::vector<agent_pair_t> prefetch_ring_; //!< pairs drawn and prefetched, but not performed
+    size_t prefetch_distance_;
+    EpochLengthController prefetch_controller_; //!< only used with kAdaptivePrefetch
+
+    // parallel processing of conflict-free blocks (only used if num_threads > 1)
+    static constexpr size_t kNoAgent = std::numeric_limits<size_t>::max();
+    static constexpr size_t kMinParallelBlock = 256; //!< smaller blocks are run sequentially
+
+    std::unique_ptr<ThreadPool> thread_pool_;
+    std::vector<agent_pair_t> block_;
+    std::optional<agent_pair_t> conflicting_pair_; //!< first pair of the next block
+    std::vector<size_t> seen_agents_; //!< open addressing hash set of agents in block
+    std::vector<size_t> used_slots_;
+    unsigned seen_shift_{0};
 
     // state
     size_t num_interactions_{0};
     size_t num_runs_{0};
     size_t num_epochs_{0};
 
-    // variant without prefetching
-    void perform_single_interaction_with_prefetch() {
-        const auto first_id = agent_distr_(prng_);
-        pps::state_t second_id;
-        do {
-            second_id = agent_distr_(prng_);
-        } while (TLX_UNLIKELY(second_id == first_id));
+    template <typename Transition>
+    void run_epoch(Transition &transition) {
+        if constexpr (kPrefetchInteractions == 0) {
+            // we still use the concept of epochs in order to keep the load on monitor
+            // roughly comparable to the batch simulator
+            for (size_t intraepoch = 0; intraepoch < epoch_length_; ++intraepoch) {
+                perform_single_interaction_with_prefetch(transition);
+            }
+        } else {
+            // the agents are drawn in small batches rather than one pair per interaction,
+            // so the PRNG runs in a tight loop while the prefetches are in flight
+            const auto ring_mask = prefetch_ring_.size() - 1;
+            size_t num_drawn = 0;
+
+            // makes sure that the pairs [intraepoch, intraepoch + num) are available
+            auto draw_ahead = [&](size_t intraepoch, size_t num) {
+                const auto ahead = intraepoch + num - 1 + prefetch_distance_;
+                if (num_drawn <= ahead) {
+                    const auto until = std::min(epoch_length_, ahead + kGenerateBatch);
+                    for (; num_drawn < until; ++num_drawn) {
+                        const auto pair = draw_pair();
+                        prefetch_pair(pair);
+                        prefetch_ring_[num_drawn & ring_mask] = pair;
+                    }
+                }
+            };
+
+            size_t intraepoch = 0;
+
+#ifdef PPS_HAS_SIMD_INTERACTIONS
+            static_assert(kSimdInteractions <= kGenerateBatch);
+            if constexpr (BitsPerState >= 8 && is_compiled_protocol<Transition>::value) {
+                if (population_.size() <= (size_t{1} << 31)) {
+                    // groups are contiguous in the ring, as its size is a power of two
+                    for (; intraepoch + kSimdInteractions <= epoch_length_;
+                         intraepoch += kSimdInteractions) {
+                        draw_ahead(intraepoch, kSimdInteractions);
+
+                        const auto *group = &prefetch_ring_[intraepoch & ring_mask];
+                        auto skipped = simd_interactions(population_.data(), transition, group);
+                        for (; skipped; skipped &= skipped - 1) {
+                            const auto [first, second] = group[__builtin_ctz(skipped) / 2];
+                            interact(transition, first, second);
+                        }
+                    }
+                }
+            }
+#endif
 
-        const auto new_states =
-            Protocols::transition(protocol_, {population_[first_id], population_[second_id]});
-        assert(new_states.first < num_states_);
-        assert(new_states.second < num_states_);
+            for (; intraepoch < epoch_length_; ++intraepoch) {
+                draw_ahead(intraepoch, 1);
 
-        population_[first_id] = new_states.first;
-        if constexpr (!Protocols::is_one_way<Protocol>) {
-            population_[second_id] = new_states.second;
+                const auto [first, second] = prefetch_ring_[intraepoch & ring_mask];
+                interact(transition, first, second);
+            }
         }
     }
 
-    // prefetched variant
-    void prefetch_pair() {
+    template <typename Transition>
+    void run_epoch_parallel(Transition &transition) {
+        for (size_t remaining = epoch_length_; remaining;) {
+            draw_conflict_free_block(remaining);
+            remaining -= block_.size();
+
+            if (block_.size() < kMinParallelBlock) {
+                for (const auto &[first, second] : block_)
+                    interact(transition, first, second);
+                continue;
+            }
+
+            thread_pool_->run([&](unsigned thread_id) {
+                const auto num_threads = thread_pool_->num_threads();
+                const auto begin = block_.data() + block_.size() * thread_id / num_threads;
+                const auto end = block_.data() + block_.size() * (thread_id + 1) / num_threads;
+
+                for (auto it = begin; it != end; ++it) {
+                    if (prefetch_distance_ && static_cast<size_t>(end - it) > prefetch_distance_)
+                        prefetch_pair(it[prefetch_distance_]);
+
+                    interact_shared(transition, it->first, it->second);
+                }
+            });
+        }
+    }
+
+    /// Fills block_ with at most max_size pairs that do not share any agent
+    void draw_conflict_free_block(size_t max_size) {
+        block_.clear();
+        for (auto slot : used_slots_)
+            seen_agents_[slot] = kNoAgent;
+        used_slots_.clear();
+
+        auto insert = [&](size_t agent) {
+            auto slot = (agent * 0x9e3779b97f4a7c15llu) >> seen_shift_;
+            while (seen_agents_[slot] != kNoAgent) {
+                if (seen_agents_[slot] == agent)
+                    return false;
+                slot = (slot + 1) & (seen_agents_.size() - 1);
+            }
+
+            seen_agents_[slot] = agent;
+            used_slots_.push_back(slot);
+            return true;
+        };
+
+        if (conflicting_pair_) {
+            // the pair does not conflict with itself, so it always starts the next block
+            insert(conflicting_pair_->first);
+            insert(conflicting_pair_->second);
+            block_.push_back(*conflicting_pair_);
+            conflicting_pair_.reset();
+        }
+
+        while (block_.size() < max_size) {
+            const auto [first, second] = draw_pair();
+
+            // no short-circuit: both agents have to be inserted
+            const bool first_is_new = insert(first);
+            const bool second_is_new = insert(second);
+            if (!(first_is_new && second_is_new)) {
+                conflicting_pair_ = agent_pair_t{first, second};
+                break;
+            }
+
+            block_.emplace_back(first, second);
+        }
+    }
+
+    // variant without prefetching
+    template <typename Transition>
+    void perform_single_interaction_with_prefetch(Transition &transition) {
+        const auto [first_id, second_id] = draw_pair();
+        interact(transition, first_id, second_id);
+    }
+
+    agent_pair_t draw_pair() {
         // first id is easy
-        pps::state_t *first = std::addressof(population_[agent_distr_(prng_)]);
-        __builtin_prefetch(first, 1); // 1 indicates that we intent to write to this position
-        prefetch_buffer_.push_back(first);
+        const auto first = agent_distr_(prng_);
 
         // second id needs to be different from first
-        pps::state_t *second;
+        size_t second;
         do {
-            second = std::addressof(population_[agent_distr_(prng_)]);
+            second = agent_distr_(prng_);
         } while (TLX_UNLIKELY(first == second));
-        __builtin_prefetch(second, !Protocols::is_one_way<Protocol>);
-        prefetch_buffer_.push_back(second);
+
+        return {first, second};
+    }
+
+    void prefetch_pair(const agent_pair_t &pair) const {
+        // 1 indicates that we intent to write to this position
+        __builtin_prefetch(population_.address(pair.first), 1);
+        __builtin_prefetch(population_.address(pair.second), !Protocols::is_one_way<Protocol>);
     }
 
-    void perform_prefetched_pair() {
-        auto *first = prefetch_buffer_.front();
-        prefetch_buffer_.pop_front();
-        auto *second = prefetch_buffer_.front();
-        prefetch_buffer_.pop_front();
+    template <typename Transition>
+    void interact(Transition &transition, size_t first, size_t second) {
+        const auto new_states =
+            Protocols::transition(transition, {population_.get(first), population_.get(second)});
+        assert(new_states.first < num_states_);
+        assert(new_states.second < num_states_);
+
+        population_.set(first, new_states.first);
+        if constexpr (!Protocols::is_one_way<Protocol>) {
+            population_.set(second, new_states.second);
+        }
+    }
 
-        const auto new_states = Protocols::transition(protocol_, {*first, *second});
+    // same as interact, but may run concurrently on disjoint agents
+    template <typename Transition>
+    void interact_shared(Transition &transition, size_t first, size_t second) {
+        const auto new_states = Protocols::transition(
+            transition, {population_.get_shared(first), population_.get_shared(second)});
         assert(new_states.first < num_states_);
         assert(new_states.second < num_states_);
 
-        *first = new_states.first;
+        population_.set_shared(first, new_states.first);
         if constexpr (!Protocols::is_one_way<Protocol>) {
-            *second = new_states.second;
+            population_.set_shared(second, new_states.second);
         }
     }
 };
@@ -19,11 +19,17 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <random>
 
 #include <tlx/define/likely.hpp>
+#include <tlx/math.hpp>
+
+#include <pps/LogGamma.hpp>
 
 #include <iostream>
 
@@ -43,53 +49,8 @@ public:
     using value_type = long long;
 
     explicit CollisionDisitribution(value_type n, value_type g = 0, value_type max_g = 0)
-        : n_(n), log_n_(std::log(n)), stage_factor_(max_g / kNumStages) {
+        : n_(n), max_g_(max_g), log_n_(std::log(n)), stage_factor_(max_g / kNumStages) {
         set_red(g);
-
-        for (size_t stage = 0; stage < kNumStages; stage++) {
-            const auto red_lower = static_cast<value_type>(stage * stage_factor_);
-            const auto red_upper = std::min<value_type>((1 + stage) * stage_factor_ + 1, max_g);
-
-            for (size_t i = 0; i < kNumEstimates; ++i) {
-                const auto rand_lower =
-                    std::max(i / static_cast<double>(kNumEstimates), std::nextafter(0.0, 1.0));
-                const auto rand_upper = (i + 1) / static_cast<double>(kNumEstimates);
-
-                auto &limits = stages_[stage][i];
-
-                limits.first = bisection(
-                    TargetFunction{rand_upper, n_ - red_upper, std::lgamma(n_ - red_upper), log_n_},
-                    0, n_ + 1);
-                limits.second = bisection(TargetFunction{rand_lower, n_ - red_lower,
-                                                         std::lgamma(n_ - red_lower), log_n_},
-                                          0, n_ + 1)
-                                + 1;
-
-                assert(limits.first <= limits.second);
-            }
-
-            for (size_t i = 0; i < kNumEstimates; ++i) {
-                const auto rand_lower =
-                    std::max(i / static_cast<double>(kNumEstimates * kNumEstimates),
-                             std::nextafter(0.0, 1.0));
-                const auto rand_upper =
-                    (i + 1) / static_cast<double>(kNumEstimates * kNumEstimates);
-
-                auto &limits = small_stages_[stage][i];
-
-                limits.first = bisection(
-                    TargetFunction{rand_upper, n_ - red_upper, std::lgamma(n_ - red_upper), log_n_},
-                    0, n_ + 1);
-                limits.second = bisection(TargetFunction{rand_lower, n_ - red_lower,
-                                                         std::lgamma(n_ - red_lower), log_n_},
-                                          0, n_ + 1)
-                                + 1;
-
-                assert(limits.first <= limits.second);
-            }
-        }
-
-        search_iters_ = 0;
     }
 
     void set_red(value_type g) {
@@ -97,6 +58,10 @@ public:
         current_stage_ = g / stage_factor_;
         assert(current_stage_ < kNumStages);
 
+        // the brackets of a stage are computed on its first use
+        if (TLX_UNLIKELY(!((built_stages_ >> current_stage_) & 1)))
+            build_stage(current_stage_);
+
         n_green_ = n_ - g;
         loggamma_n_green_ = std::lgamma(n_green_);
     }
@@ -158,6 +123,7 @@ private:
 
     value_type n_;
     value_type n_green_;
+    value_type max_g_;
 
     estimator_stage_type stages_[kNumStages];
     estimator_stage_type small_stages_[kNumStages];
@@ -167,10 +133,133 @@ private:
     double stage_factor_;
 
     size_t current_stage_;
+    uint32_t built_stages_{0}; //!< bit i is set iff stages_[i] and small_stages_[i] are valid
+    static_assert(kNumStages <= 32, "built_stages_ has too few bits");
 
     std::uniform_real_distribution<double> unif_{std::nextafter(0.0, 1.0),
                                                  std::nextafter(1.0, 2.0)};
 
+    class TargetFunction {
+    public:
+        TargetFunction() = default;
+
+        TargetFunction(double rand, value_type n_green, double loggamma_n_green, double log_n)
+            : target_{std::log(rand) - loggamma_n_green}, log_n_{log_n}, n_green_(n_green) {}
+
+        double operator()(double k) const {
+            return target_ + std::lgamma(n_green_ - k) + k * log_n_;
+        }
+
+        double target() const noexcept { return target_; }
+
+        size_t n_green() const noexcept { return n_green_; }
+
+    private:
+        double target_;
+        double log_n_;
+        size_t n_green_;
+    };
+
+    /**
+     * Computes the brackets of all estimators of a stage, i.e. 4 * kNumEstimates quantiles, each
+     * the result of bisection(TargetFunction{...}, 0, n_ + 1). Rather than carrying out these
+     * searches one by one, we advance all of them in lockstep and evaluate the target functions
+     * with the auto-vectorized log_gamma::lgamma. As the approximation may shift a quantile by
+     * a few positions, each result is finally corrected with a few evaluations based on
+     * std::lgamma; hence the brackets match the ones of the scalar searches (for n beyond 1e10,
+     * the rounding noise of the target function exceeds its slope, and both may settle on
+     * different crossings within the noise).
+     */
+    void build_stage(size_t stage) {
+        constexpr size_t kNumBrackets = 4 * kNumEstimates;
+
+        const auto red_lower = static_cast<value_type>(stage * stage_factor_);
+        const auto red_upper = std::min<value_type>((1 + stage) * stage_factor_ + 1, max_g_);
+        const auto loggamma_upper = std::lgamma(n_ - red_upper);
+        const auto loggamma_lower = std::lgamma(n_ - red_lower);
+
+        // the lower end of an estimator's bracket is based on the fewest green balls and the
+        // largest random value of the stage; the upper end vice versa
+        std::array<TargetFunction, kNumBrackets> targets;
+        for (size_t i = 0; i < kNumEstimates; ++i) {
+            for (size_t small = 0; small < 2; ++small) {
+                const auto resolution =
+                    static_cast<double>(small ? kNumEstimates * kNumEstimates : kNumEstimates);
+                const auto rand_lower = std::max(i / resolution, std::nextafter(0.0, 1.0));
+                const auto rand_upper = (i + 1) / resolution;
+
+                const auto idx = 2 * (small * kNumEstimates + i);
+                targets[idx] = TargetFunction{rand_upper, n_ - red_upper, loggamma_upper, log_n_};
+                targets[idx + 1] =
+                    TargetFunction{rand_lower, n_ - red_lower, loggamma_lower, log_n_};
+            }
+        }
+
+        // lockstep bisections on doubles; integers below 2^53 are exact. The midpoint rounds
+        // half the width to the nearest integer with the 2^52 trick, as std::floor is not
+        // vectorized on all targets
+        constexpr double kRound = 4503599627370496.0;
+        alignas(64) std::array<double, kNumBrackets> left, right, offset, green;
+        for (size_t i = 0; i < kNumBrackets; ++i) {
+            left[i] = 0.0;
+            right[i] = static_cast<double>(n_ + 1);
+            offset[i] = targets[i].target();
+            green[i] = static_cast<double>(targets[i].n_green());
+        }
+
+        const auto rounds = tlx::integer_log2_ceil(static_cast<uint64_t>(n_ + 1)) + 1;
+        const auto log_n = log_n_;
+        for (unsigned round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < kNumBrackets; ++i) {
+                const auto width = right[i] - left[i];
+                const auto mid = left[i] + ((width * 0.5 + kRound) - kRound);
+                const auto value = offset[i] + log_gamma::lgamma(green[i] - mid) + mid * log_n;
+
+                const double active = (width >= 2.0);
+                const double to_left = active * (value > 0.0);
+                const double to_right = active - to_left;
+                right[i] += to_left * (mid - right[i]);
+                left[i] += to_right * (mid - left[i]);
+            }
+        }
+
+        const auto search_iters = search_iters_;
+        for (size_t i = 0; i < kNumEstimates; ++i) {
+            for (size_t small = 0; small < 2; ++small) {
+                const auto idx = 2 * (small * kNumEstimates + i);
+                auto &limits = (small ? small_stages_ : stages_)[stage][i];
+
+                limits.first = exact_quantile(targets[idx], static_cast<value_type>(left[idx]));
+                limits.second =
+                    exact_quantile(targets[idx + 1], static_cast<value_type>(left[idx + 1])) + 1;
+
+                assert(limits.first <= limits.second);
+            }
+        }
+        search_iters_ = search_iters;
+
+        built_stages_ |= uint32_t{1} << stage;
+    }
+
+    /// Returns bisection(f, 0, n_ + 1) given a guess close to it: we gallop from the guess until
+    /// we bracket the sign change of f, and bisect the (typically empty) remainder
+    value_type exact_quantile(const TargetFunction &f, value_type guess) noexcept {
+        auto lo = guess;
+        auto hi = guess + 1;
+
+        for (value_type step = 1; lo > 0 && f(lo) > 0; step *= 2) {
+            hi = lo;
+            lo = std::max<value_type>(0, lo - step);
+        }
+
+        for (value_type step = 1; hi <= n_ && f(hi) <= 0; step *= 2) {
+            lo = hi;
+            hi = std::min<value_type>(n_ + 1, hi + step);
+        }
+
+        return bisection(f, lo, hi);
+    }
+
     template <typename F>
     value_type bisection(F &&f, value_type left, value_type right) noexcept {
         assert(left <= right);
@@ -249,21 +338,6 @@ private:
                          std::min(x1int, static_cast<value_type>(x1) + 1));
     }
 
-    class TargetFunction {
-    public:
-        TargetFunction(double rand, value_type n_green, double loggamma_n_green, double log_n)
-            : target_{std::log(rand) - loggamma_n_green}, log_n_{log_n}, n_green_(n_green) {}
-
-        double operator()(double k) const {
-            return target_ + std::lgamma(n_green_ - k) + k * log_n_;
-        }
-
-    private:
-        double target_;
-        double log_n_;
-        size_t n_green_;
-    };
-
     value_type midpoint(value_type left, value_type right) const {
         return left + (right - left) / 2;
     }
@@ -0,0 +1,233 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <tlx/define/likely.hpp>
+
+#include <pps/TabulatedCollisionDistribution.hpp>
+#include <urns/BoundedUniform.hpp>
+
+namespace pps {
+
+/// Urn from which an agent of a planted collision is taken
+enum class AgentSource : uint8_t { Untouched, Delayed, Updated };
+
+struct ScheduledRun {
+    uint64_t new_delayed_agents; //!< agents added to the delayed ones before the collision
+    AgentSource first;
+    AgentSource second;
+};
+
+/**
+ * Generates the sequence of runs of an epoch of the AsyncBatchSimulator. The run lengths
+ * as well as the decision from which urn an colliding agent is drawn only depend on the
+ * number of delayed, updated, and total agents -- but not on the agents' states. We hence
+ * simulate these counters here, which allows to compute the schedule independently of
+ * (and concurrently to) the urn operations.
+ */
+class CollisionScheduler {
+public:
+    CollisionScheduler(size_t num_agents, size_t max_epoch_length)
+        : num_agents_(num_agents), collision_distr_(num_agents, 0, max_epoch_length) {}
+
+    /// Reset counters; each epoch starts without delayed and updated agents
+    void start_epoch(size_t target_epoch_length) noexcept {
+        target_epoch_length_ = target_epoch_length;
+        num_delayed_agents_ = 0;
+        num_updated_agents_ = 0;
+    }
+
+    /// Returns the next run of the current epoch, or nothing if the epoch is complete
+    template <typename Gen>
+    std::optional<ScheduledRun> next(Gen &gen) {
+        if (num_delayed_agents_ + num_updated_agents_ >= target_epoch_length_)
+            return {};
+
+        ScheduledRun run;
+
+        // sample length of next round
+        auto num_colliding_agents = num_delayed_agents_ + num_updated_agents_;
+        collision_distr_.set_red(num_colliding_agents);
+        size_t round_length;
+        do {
+            round_length = collision_distr_(gen);
+        } while (!num_colliding_agents && round_length < 2);
+        run.new_delayed_agents = 2 * (round_length / 2);
+        num_delayed_agents_ += run.new_delayed_agents;
+
+        // helper to select the urn an agent is taken from
+        num_colliding_agents = num_delayed_agents_ + num_updated_agents_;
+        auto select_source = [&](bool has_collision) {
+            if (!has_collision)
+                return AgentSource::Untouched;
+
+            if (with_probability_(gen, num_delayed_agents_, num_colliding_agents)) {
+                // two delayed agents interact; one of them is stored as updated
+                num_delayed_agents_ -= 2;
+                num_updated_agents_++;
+                return AgentSource::Delayed;
+            }
+
+            num_updated_agents_--;
+            return AgentSource::Updated;
+        };
+
+        // plant collision
+        const auto has_collision_on_first = (round_length % 2 == 0);
+        const auto has_collision_on_second =
+            !has_collision_on_first || with_probability_(gen, num_colliding_agents, num_agents_);
+        run.first = select_source(has_collision_on_first);
+        run.second = select_source(has_collision_on_second);
+
+        // both agents of the collision are updated
+        num_updated_agents_ += 2;
+
+        assert(num_delayed_agents_ % 2 == 0);
+        return run;
+    }
+
+private:
+    size_t num_agents_;
+    size_t target_epoch_length_{0};
+    size_t num_delayed_agents_{0};
+    size_t num_updated_agents_{0};
+
+    TabulatedCollisionDistribution collision_distr_;
+
+    template <typename Gen>
+    bool with_probability_(Gen &gen, size_t good, size_t total) {
+        return urns::UniformInt<size_t>{1, total}(gen) <= good;
+    }
+};
+
+/**
+ * Runs a CollisionScheduler on a helper thread which writes the schedule into a lock-free
+ * single-producer/single-consumer ring buffer. The producer works ahead by at most
+ * kMaxEpochsAhead epochs, i.e. it may compute the schedule of the next epoch while the
+ * consumer still processes the current one. Hence, a new target epoch length is picked up
+ * by the epoch after next at the latest, which keeps the feedback of the
+ * EpochLengthController intact.
+ */
+class AsyncCollisionScheduler {
+public:
+    //! Epochs the producer may complete beyond the one currently consumed
+    static constexpr size_t kMaxEpochsAhead = 1;
+
+    //! An epoch has about T^2 / 2n runs; longer epochs only block the producer more often
+    static constexpr size_t kCapacity = 1llu << 10;
+
+    AsyncCollisionScheduler(size_t num_agents, size_t max_epoch_length, size_t target_epoch_length,
+                            uint64_t seed)
+        : scheduler_(num_agents, max_epoch_length), prng_(seed), ring_(kCapacity),
+          target_epoch_length_(target_epoch_length) {
+        producer_ = std::thread(&AsyncCollisionScheduler::producer_main, this);
+    }
+
+    AsyncCollisionScheduler(const AsyncCollisionScheduler &) = delete;
+    AsyncCollisionScheduler &operator=(const AsyncCollisionScheduler &) = delete;
+
+    ~AsyncCollisionScheduler() {
+        running_ = false;
+        producer_.join();
+    }
+
+    /// Target used for all epochs the producer did not start yet
+    void set_target_epoch_length(size_t target) noexcept {
+        target_epoch_length_.store(target, std::memory_order_relaxed);
+    }
+
+    /// Blocks until the next run is available; returns nothing at the end of an epoch
+    std::optional<ScheduledRun> next() noexcept {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        while (TLX_UNLIKELY(head_.load(std::memory_order_acquire) == tail))
+            std::this_thread::yield();
+
+        const auto slot = ring_[tail % kCapacity];
+        tail_.store(tail + 1, std::memory_order_release);
+
+        if (!slot)
+            epochs_consumed_.store(epochs_consumed_.load(std::memory_order_relaxed) + 1,
+                                   std::memory_order_release);
+
+        return slot;
+    }
+
+private:
+    CollisionScheduler scheduler_;
+    std::mt19937_64 prng_;
+
+    // an empty slot marks the end of an epoch
+    std::vector<std::optional<ScheduledRun>> ring_;
+    alignas(64) std::atomic<size_t> head_{0}; //!< next slot written by producer
+    alignas(64) std::atomic<size_t> tail_{0}; //!< next slot read by consumer
+
+    std::atomic<size_t> epochs_consumed_{0}; //!< end markers read by the consumer
+    size_t epochs_produced_{0};              //!< end markers written by the producer
+
+    std::atomic<size_t> target_epoch_length_;
+    std::atomic<bool> running_{true};
+    std::thread producer_;
+
+    bool push(std::optional<ScheduledRun> run) noexcept {
+        const auto head = head_.load(std::memory_order_relaxed);
+        while (TLX_UNLIKELY(head - tail_.load(std::memory_order_acquire) == kCapacity)) {
+            if (!running_)
+                return false;
+            std::this_thread::yield();
+        }
+
+        ring_[head % kCapacity] = run;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void producer_main() {
+        while (running_) {
+            // do not run further ahead; the target length of later epochs is not known yet
+            while (epochs_produced_
+                   > epochs_consumed_.load(std::memory_order_acquire) + kMaxEpochsAhead) {
+                if (!running_)
+                    return;
+                std::this_thread::yield();
+            }
+
+            scheduler_.start_epoch(target_epoch_length_.load(std::memory_order_relaxed));
+
+            bool epoch_complete = false;
+            while (!epoch_complete) {
+                auto run = scheduler_.next(prng_);
+                epoch_complete = !run;
+                if (!push(run))
+                    return;
+            }
+            epochs_produced_++;
+        }
+    }
+};
+
+} // namespace pps
@@ -0,0 +1,203 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+
+#include <tlx/math.hpp>
+
+#include <pps/Protocols.hpp>
+
+namespace pps {
+
+namespace Protocols {
+struct TwoWayProtocolTag {};
+} // namespace Protocols
+
+/**
+ * Deterministic protocol that looks up the transitions of another deterministic protocol in
+ * a dense table. Each row has a power-of-two stride, so the lookup is a shift, an or, and a
+ * single load. Entries store the resulting states with Entry bits each (two per entry for
+ * two-way protocols). The wrapped protocol is evaluated once during construction and hence
+ * has to be a pure function of the two input states. The table is followed by a few
+ * padding cells, so that vectorized lookups may read four bytes at any cell.
+ */
+template <typename Protocol, typename Entry>
+class CompiledProtocol
+    : public Protocols::DeterministicProtocol,
+      public std::conditional_t<Protocols::is_one_way<Protocol>, Protocols::OneWayProtocol,
+                                Protocols::TwoWayProtocolTag> {
+    static constexpr bool kOneWay = Protocols::is_one_way<Protocol>;
+
+    struct PackedPair {
+        Entry first;
+        Entry second;
+    };
+    using cell_type = std::conditional_t<kOneWay, Entry, PackedPair>;
+
+public:
+    using entry_type = Entry;
+
+    /// transitions[first * num_states + second] is the result of interaction (first, second)
+    CompiledProtocol(const std::vector<state_pair_t> &transitions, state_t num_states)
+        : num_states_(num_states),
+          row_shift_(tlx::integer_log2_ceil(std::max<state_t>(num_states, 2))),
+          table_((static_cast<size_t>(num_states) << row_shift_) + kPaddingCells) {
+        assert(transitions.size() == static_cast<size_t>(num_states) * num_states);
+
+        for (state_t first = 0; first < num_states; ++first) {
+            for (state_t second = 0; second < num_states; ++second) {
+                const auto to = transitions[first * num_states + second];
+                assert(to.first <= std::numeric_limits<Entry>::max());
+                assert(to.second <= std::numeric_limits<Entry>::max());
+
+                auto &cell = table_[index(first, second)];
+                if constexpr (kOneWay) {
+                    assert(to.second == second);
+                    cell = static_cast<Entry>(to.first);
+                } else {
+                    cell = PackedPair{static_cast<Entry>(to.first), static_cast<Entry>(to.second)};
+                }
+            }
+        }
+    }
+
+    auto operator()(state_t first, state_t second) const noexcept {
+        assert(first < num_states_);
+        assert(second < num_states_);
+        const auto cell = table_[index(first, second)];
+
+        if constexpr (kOneWay) {
+            return static_cast<state_t>(cell);
+        } else {
+            return state_pair_t{cell.first, cell.second};
+        }
+    }
+
+    state_t num_states() const noexcept { return num_states_; }
+
+    size_t table_bytes() const noexcept { return table_.size() * sizeof(cell_type); }
+
+    /// Cell (first, second) is at data()[(first << row_shift()) | second]
+    const cell_type *data() const noexcept { return table_.data(); }
+
+    unsigned row_shift() const noexcept { return row_shift_; }
+
+private:
+    static constexpr size_t kPaddingCells = 4;
+
+    state_t num_states_;
+    unsigned row_shift_;
+    std::vector<cell_type> table_;
+
+    size_t index(state_t first, state_t second) const noexcept {
+        return (static_cast<size_t>(first) << row_shift_) | second;
+    }
+};
+
+namespace Protocols {
+
+/// Size of the L2 cache in bytes as reported by the OS (or a conservative guess)
+inline size_t l2_cache_size() {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    const auto size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (size > 0)
+        return static_cast<size_t>(size);
+#endif
+    return 256 * 1024;
+}
+
+template <typename Protocol>
+using CompiledVariant = std::variant<std::monostate, CompiledProtocol<Protocol, uint8_t>,
+                                     CompiledProtocol<Protocol, uint16_t>,
+                                     CompiledProtocol<Protocol, uint32_t>>;
+
+/**
+ * Tabulates a deterministic protocol using the narrowest entries that can hold all
+ * resulting states. Returns std::monostate if the protocol is not deterministic or if the
+ * table would exceed max_bytes (by default the L2 cache size); in this case the caller
+ * should keep using the original protocol.
+ */
+template <typename Protocol>
+CompiledVariant<Protocol> compile(Protocol &protocol, state_t num_states,
+                                  size_t max_bytes = l2_cache_size()) {
+    if constexpr (!is_deterministic<Protocol>) {
+        return {};
+    } else {
+        const auto cells = static_cast<size_t>(num_states)
+                           << tlx::integer_log2_ceil(std::max<state_t>(num_states, 2));
+        const auto entries_per_cell = is_one_way<Protocol> ? 1 : 2;
+
+        // cheap test before evaluating the protocol
+        if (cells * entries_per_cell > max_bytes)
+            return {};
+
+        std::vector<state_pair_t> transitions;
+        transitions.reserve(static_cast<size_t>(num_states) * num_states);
+        state_t max_state = num_states - 1;
+        for (state_t first = 0; first < num_states; ++first) {
+            for (state_t second = 0; second < num_states; ++second) {
+                const auto to = transition(protocol, {first, second});
+                max_state = std::max({max_state, to.first, to.second});
+                transitions.push_back(to);
+            }
+        }
+
+        auto fits = [&](size_t entry_bytes, state_t max_entry) {
+            return max_state <= max_entry && cells * entries_per_cell * entry_bytes <= max_bytes;
+        };
+
+        if (fits(1, std::numeric_limits<uint8_t>::max()))
+            return CompiledProtocol<Protocol, uint8_t>(transitions, num_states);
+        if (fits(2, std::numeric_limits<uint16_t>::max()))
+            return CompiledProtocol<Protocol, uint16_t>(transitions, num_states);
+        if (fits(4, std::numeric_limits<uint32_t>::max()))
+            return CompiledProtocol<Protocol, uint32_t>(transitions, num_states);
+        return {};
+    }
+}
+
+/// Invokes cb with the compiled protocol if available, and with protocol otherwise
+template <typename Protocol, typename Callback>
+decltype(auto) visit_compiled(Protocol &protocol, CompiledVariant<Protocol> &compiled,
+                              Callback &&cb) {
+    return std::visit(
+        [&](auto &alternative) -> decltype(auto) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(alternative)>, std::monostate>) {
+                return cb(protocol);
+            } else {
+                return cb(alternative);
+            }
+        },
+        compiled);
+}
+
+} // namespace Protocols
+} // namespace pps
@@ -128,6 +128,9 @@ private:
     size_t update_value(States state) {
         auto value =
             static_cast<size_t>(current_best_ * (1.0 + (static_cast<int>(state) - 1) * 0.1));
+        // small values (e.g., prefetch distances) would otherwise never grow
+        if (state == MeasureAbove && value == current_best_)
+            ++value;
         if (value < min_)
             return min_;
         if (value > max_)
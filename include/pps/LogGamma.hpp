@@ -0,0 +1,96 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace pps {
+
+/**
+ * Branch-free approximations of log(x) and lgamma(x) built from arithmetic and bit operations
+ * only. Unlike calls into libm, loops over these functions get auto-vectorized. Both are
+ * accurate to roughly 1e-13 (relative) for the arguments we use them on, which is good enough
+ * to compute starting points of searches that are then finished with std::lgamma.
+ */
+namespace log_gamma {
+
+/// Natural logarithm for normal, positive x
+inline double log(double x) noexcept {
+    constexpr double kLn2Hi = 6.93147180369123816490e-01;
+    constexpr double kLn2Lo = 1.90821492927058770002e-10;
+    constexpr double kSqrt2 = 1.41421356237309504880;
+
+    // x = m * 2^e with m in [1, 2)
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(x));
+    auto exponent = static_cast<double>(static_cast<int64_t>(bits >> 52) - 1023);
+    bits = (bits & ((uint64_t{1} << 52) - 1)) | (uint64_t{1023} << 52);
+    double m;
+    std::memcpy(&m, &bits, sizeof(m));
+
+    // move m into [sqrt(1/2), sqrt(2)) to keep s below 0.172
+    const double halve = (m > kSqrt2);
+    m *= 1.0 - 0.5 * halve;
+    exponent += halve;
+
+    // log(m) = 2 atanh(s) = 2 (s + s^3 / 3 + s^5 / 5 + ...) with s = (m - 1) / (m + 1)
+    const auto s = (m - 1.0) / (m + 1.0);
+    const auto s2 = s * s;
+    auto series = 1.0 / 21;
+    series = series * s2 + 1.0 / 19;
+    series = series * s2 + 1.0 / 17;
+    series = series * s2 + 1.0 / 15;
+    series = series * s2 + 1.0 / 13;
+    series = series * s2 + 1.0 / 11;
+    series = series * s2 + 1.0 / 9;
+    series = series * s2 + 1.0 / 7;
+    series = series * s2 + 1.0 / 5;
+    series = series * s2 + 1.0 / 3;
+
+    return exponent * kLn2Hi + (exponent * kLn2Lo + 2.0 * s * (1.0 + s2 * series));
+}
+
+/// log(Gamma(x)) for x >= 1; smaller arguments are treated as 1 (i.e. yield 0)
+inline double lgamma(double x) noexcept {
+    constexpr double kHalfLog2Pi = 0.91893853320467274178;
+    constexpr double kShift = 6.0;
+
+    // (no std::max, as it keeps gcc from vectorizing callers)
+    const double too_small = (x < 1.0);
+    x += too_small * (1.0 - x);
+
+    // Gamma(x) = Gamma(x + 6) / (x (x+1) ... (x+5)) and Stirling's series for x + 6 >= 7
+    const auto z = x + kShift;
+    const auto product = x * (x + 1.0) * (x + 2.0) * (x + 3.0) * (x + 4.0) * (x + 5.0);
+
+    const auto inv = 1.0 / z;
+    const auto inv2 = inv * inv;
+    auto series = 1.0 / 1188;
+    series = series * inv2 - 1.0 / 1680;
+    series = series * inv2 + 1.0 / 1260;
+    series = series * inv2 - 1.0 / 360;
+    series = series * inv2 + 1.0 / 12;
+
+    return (z - 0.5) * log(z) - z + kHalfLog2Pi + series * inv - log(product);
+}
+
+} // namespace log_gamma
+} // namespace pps
@@ -0,0 +1,152 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <pps/Protocols.hpp>
+
+namespace pps {
+
+/// Smallest number of bits per agent supported by PackedPopulation to store num_states states
+constexpr unsigned bits_per_state(state_t num_states) noexcept {
+    for (unsigned bits = 1; bits < 32; bits *= 2) {
+        if (num_states <= (1u << bits))
+            return bits;
+    }
+    return 32;
+}
+
+/**
+ * Stores the states of n agents with Bits bits each. For Bits >= 8 every agent occupies its
+ * own integer; smaller states are packed into 64 bit words, so that a population of 2^34
+ * agents with two states takes 2 GB rather than 64 GB.
+ */
+template <unsigned Bits>
+class PackedPopulation {
+    static_assert(Bits == 1 || Bits == 2 || Bits == 4 || Bits == 8 || Bits == 16 || Bits == 32,
+                  "Bits per state must be a power of two not exceeding 32");
+
+public:
+    static constexpr unsigned kBits = Bits;
+    static constexpr bool kPacked = (Bits < 8);
+
+    using word_type = std::conditional_t<
+        kPacked, uint64_t,
+        std::conditional_t<Bits == 8, uint8_t, std::conditional_t<Bits == 16, uint16_t, uint32_t>>>;
+
+    static constexpr size_t kStatesPerWord = 8 * sizeof(word_type) / Bits;
+    static constexpr word_type kMask = static_cast<word_type>((uint64_t{1} << Bits) - 1);
+
+    /// Vectorized kernels read four bytes starting at an agent; so we pad 8 and 16 bit states
+    static constexpr size_t kPaddingWords = kPacked ? 0 : sizeof(uint32_t) / sizeof(word_type) - 1;
+
+    explicit PackedPopulation(size_t size = 0)
+        : size_(size), words_((size + kStatesPerWord - 1) / kStatesPerWord + kPaddingWords, 0) {}
+
+    size_t size() const noexcept { return size_; }
+
+    state_t operator[](size_t i) const noexcept { return get(i); }
+
+    state_t get(size_t i) const noexcept {
+        assert(i < size_);
+        if constexpr (kPacked) {
+            return static_cast<state_t>((words_[i / kStatesPerWord] >> shift(i)) & kMask);
+        } else {
+            return words_[i];
+        }
+    }
+
+    void set(size_t i, state_t value) noexcept {
+        assert(i < size_);
+        assert(value <= kMask);
+        if constexpr (kPacked) {
+            auto &word = words_[i / kStatesPerWord];
+            word = (word & ~(kMask << shift(i))) | (static_cast<word_type>(value) << shift(i));
+        } else {
+            words_[i] = static_cast<word_type>(value);
+        }
+    }
+
+    /**
+     * Variants of get and set that may be called concurrently by several threads as long as
+     * each agent is accessed by at most one of them. Packed agents share words with others,
+     * so we update them with an atomic xor of the changed bits.
+     */
+    state_t get_shared(size_t i) const noexcept {
+        assert(i < size_);
+        if constexpr (kPacked) {
+            const auto word = __atomic_load_n(&words_[i / kStatesPerWord], __ATOMIC_RELAXED);
+            return static_cast<state_t>((word >> shift(i)) & kMask);
+        } else {
+            return words_[i];
+        }
+    }
+
+    void set_shared(size_t i, state_t value) noexcept {
+        assert(i < size_);
+        assert(value <= kMask);
+        if constexpr (kPacked) {
+            const auto diff = static_cast<word_type>(get_shared(i) ^ value) << shift(i);
+            if (diff)
+                __atomic_fetch_xor(&words_[i / kStatesPerWord], diff, __ATOMIC_RELAXED);
+        } else {
+            words_[i] = static_cast<word_type>(value);
+        }
+    }
+
+    /// Sets the agents [begin, begin + num) to value
+    void fill(size_t begin, size_t num, state_t value) noexcept {
+        for (size_t i = begin; i < begin + num; ++i)
+            set(i, value);
+    }
+
+    /// Raw storage, e.g. for vectorized kernels
+    word_type *data() noexcept { return words_.data(); }
+
+    /// Address of the word holding agent i; e.g. to be used with __builtin_prefetch
+    const void *address(size_t i) const noexcept { return words_.data() + i / kStatesPerWord; }
+
+    /// Calls cb(state) for each agent in order
+    template <typename Callback>
+    void for_each(Callback &&cb) const {
+        for (size_t i = 0; i < size_; ++i)
+            cb(get(i));
+    }
+
+    /// Bytes taken by the states of the agents (excluding the few padding words)
+    size_t memory_bytes() const noexcept {
+        return (words_.size() - kPaddingWords) * sizeof(word_type);
+    }
+
+private:
+    size_t size_;
+    std::vector<word_type> words_;
+
+    static constexpr unsigned shift(size_t i) noexcept {
+        return static_cast<unsigned>(i % kStatesPerWord) * Bits;
+    }
+};
+
+} // namespace pps
@@ -159,5 +159,41 @@ OneWayPartitions parition_oneway_transactions(const Protocol &protocol, unsigned
     return mapping;
 }
 
+using TwoWayPartitions =
+    std::vector<std::vector<std::pair<std::vector<state_t>, state_pair_t>>>;
+
+/**
+ * For each first state, group all second states by the pair of states the interaction
+ * results in. If exclude_unchanged is set, second states are omitted if the interaction
+ * does not change the agents (see transactions_without_change).
+ */
+template <typename Protocol>
+TwoWayPartitions parition_twoway_transactions(const Protocol &protocol, unsigned num_states,
+                                              bool exclude_unchanged = false) {
+    TwoWayPartitions mapping;
+    for (state_t first = 0; first < num_states; ++first) {
+        std::map<state_pair_t, std::vector<state_t>> row_map;
+        for (state_t second = 0; second < num_states; ++second) {
+            const auto from = state_pair_t{first, second};
+            const auto to = transition(protocol, from);
+            const auto no_change =
+                (from == to) || (from.first == to.second && from.second == to.first);
+
+            if (exclude_unchanged && no_change)
+                continue;
+
+            row_map[to].emplace_back(from.second);
+        }
+
+        mapping.emplace_back();
+        mapping.back().reserve(row_map.size());
+        for (auto &grp : row_map) {
+            mapping.back().emplace_back(std::move(grp.second), grp.first);
+        }
+    }
+
+    return mapping;
+}
+
 } // namespace Protocols
 } // namespace pps
@@ -0,0 +1,152 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+// opt-in (see CMake option PPS_SIMD_INTERACTIONS); on CPUs with slow gathers the scalar
+// code is faster, since drawing the agents dominates the costs of an interaction
+#if defined(PPS_SIMD_INTERACTIONS) && defined(__AVX512F__) && defined(__AVX512CD__)
+#include <immintrin.h>
+#define PPS_HAS_SIMD_INTERACTIONS 1
+#endif
+
+#include <pps/CompiledProtocol.hpp>
+#include <pps/Protocols.hpp>
+
+namespace pps {
+
+template <typename T>
+struct is_compiled_protocol : std::false_type {};
+
+template <typename Protocol, typename Entry>
+struct is_compiled_protocol<CompiledProtocol<Protocol, Entry>> : std::true_type {};
+
+#ifdef PPS_HAS_SIMD_INTERACTIONS
+
+/// Number of interactions processed by simd_interactions
+constexpr size_t kSimdInteractions = 8;
+
+/**
+ * Carries out the kSimdInteractions interactions given by the agent pairs (first, second)
+ * on a population with one 8, 16, or 32 bit word per agent. The 16 agents are gathered into
+ * a single AVX-512 register, the results are looked up in the table of the compiled protocol
+ * with a gather, and written back. Narrow states are gathered as the 32 bit word starting at
+ * the agent (which is why PackedPopulation pads its storage) and masked; since neighbouring
+ * agents share such a word, they are written back with scalar stores rather than a scatter.
+ *
+ * Interactions sharing an agent with another one of the group are skipped (detected with
+ * vpconflictd); all others are independent, so executing them first does not change the
+ * result. Returns the skipped interactions as a bit mask (bit 2k for interaction k); the
+ * caller has to carry them out in order. All agent ids have to be below 2^31.
+ *
+ * We avoid intrinsics that GCC 12 implements with _mm512_undefined_* (unmasked gathers and
+ * shifts, reductions, conversions to 256 bit), as they raise -Wmaybe-uninitialized in its
+ * headers; we use the masked variants with an explicit zero source instead.
+ */
+template <typename Word, typename Compiled>
+uint32_t simd_interactions(Word *population, const Compiled &protocol,
+                           const std::pair<size_t, size_t> *pairs) noexcept {
+    static_assert(sizeof(std::pair<size_t, size_t>) == 16, "Pairs have to be packed");
+    static_assert(sizeof(Word) == 1 || sizeof(Word) == 2 || sizeof(Word) == 4,
+                  "Agents have to be stored in 8, 16, or 32 bit words");
+    using entry_type = typename Compiled::entry_type;
+    constexpr bool kOneWay = Protocols::is_one_way<Compiled>;
+    constexpr int kEntryBytes = sizeof(entry_type);
+    constexpr int kStateBytes = sizeof(Word);
+
+    // agents in lanes [first0, second0, first1, second1, ...]; take the lower halves of the
+    // eight 64 bit ids in each of the two registers
+    const auto *raw = reinterpret_cast<const __m512i *>(pairs);
+    const __m512i agents = _mm512_permutex2var_epi32(
+        _mm512_loadu_si512(raw),
+        _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30),
+        _mm512_loadu_si512(raw + 1));
+
+    // lane i has bit j set, iff j < i and both lanes hold the same agent
+    alignas(64) uint32_t conflicts[16];
+    _mm512_store_si512(conflicts, _mm512_conflict_epi32(agents));
+    uint32_t conflicting_lanes = 0;
+    for (unsigned lane = 0; lane < 16; ++lane)
+        conflicting_lanes |= conflicts[lane] | ((conflicts[lane] != 0) << lane);
+
+    const uint32_t skipped = (conflicting_lanes | (conflicting_lanes >> 1)) & 0x5555;
+    auto write_mask = static_cast<__mmask16>(~(skipped | (skipped << 1)));
+    if (kOneWay)
+        write_mask &= 0x5555;
+
+    // each 64 bit lane holds the states (second << 32 | first) of an interaction
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i states = _mm512_mask_i32gather_epi32(zero, 0xffff, agents, population, kStateBytes);
+    if constexpr (kStateBytes < 4)
+        states = _mm512_and_si512(states, _mm512_set1_epi32((1 << (8 * kStateBytes)) - 1));
+
+    // the cell (first << row_shift | second) of each interaction in the even 32 bit lanes
+    const __m512i cells = _mm512_or_si512(
+        _mm512_maskz_sllv_epi64(0xff, states, _mm512_set1_epi64(protocol.row_shift())),
+        _mm512_maskz_srli_epi64(0xff, states, 32));
+
+    // gathers read four bytes, which is why the compiled table is padded
+    const auto *table = reinterpret_cast<const int *>(protocol.data());
+    constexpr __mmask16 kEven = 0x5555;
+    __m512i new_first, new_second;
+    if constexpr (kOneWay) {
+        new_first = _mm512_mask_i32gather_epi32(zero, kEven, cells, table, kEntryBytes);
+        new_second = zero;
+    } else if constexpr (kEntryBytes == 4) {
+        new_first = _mm512_mask_i32gather_epi32(zero, kEven, cells, table, 8);
+        new_second = _mm512_mask_i32gather_epi32(zero, kEven, cells, table + 1, 8);
+    } else {
+        const __m512i packed =
+            _mm512_mask_i32gather_epi32(zero, kEven, cells, table, 2 * kEntryBytes);
+        new_first = packed;
+        new_second = _mm512_maskz_srli_epi32(kEven, packed, 8 * kEntryBytes);
+    }
+
+    if constexpr (kEntryBytes < 4) {
+        const __m512i entry_mask = _mm512_set1_epi64((1 << (8 * kEntryBytes)) - 1);
+        new_first = _mm512_and_si512(new_first, entry_mask);
+        new_second = _mm512_and_si512(new_second, entry_mask);
+    }
+
+    const __m512i new_states =
+        _mm512_or_si512(new_first, _mm512_maskz_slli_epi64(0xff, new_second, 32));
+
+    if constexpr (kStateBytes == 4) {
+        _mm512_mask_i32scatter_epi32(population, write_mask, agents, new_states, 4);
+    } else {
+        alignas(64) uint32_t ids[16], values[16];
+        _mm512_store_si512(ids, agents);
+        _mm512_store_si512(values, new_states);
+        for (uint32_t mask = write_mask; mask; mask &= mask - 1) {
+            const auto lane = __builtin_ctz(mask);
+            population[ids[lane]] = static_cast<Word>(values[lane]);
+        }
+    }
+
+    return skipped;
+}
+
+#endif
+
+} // namespace pps
@@ -0,0 +1,152 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include <pps/Protocols.hpp>
+
+namespace pps {
+
+/**
+ * Square bit matrix where bit (first, second) indicates that an interaction between
+ * the two states does not change the agents (see Protocols::transactions_without_change).
+ * Each row is padded to full 64 bit words, so that masked sums over count arrays may
+ * safely read whole words of the mask.
+ */
+class SkipMasks {
+public:
+    SkipMasks() = default;
+
+    explicit SkipMasks(const std::vector<std::vector<state_t>> &skip_lists)
+        : num_states_(skip_lists.size()), words_per_row_((num_states_ + 63) / 64),
+          bits_(num_states_ * words_per_row_, 0) {
+        for (state_t first = 0; first < num_states_; ++first)
+            for (state_t second : skip_lists[first])
+                bits_[first * words_per_row_ + second / 64] |= uint64_t{1} << (second % 64);
+    }
+
+    bool test(state_t first, state_t second) const noexcept {
+        assert(first < num_states_ && second < num_states_);
+        return (bits_[first * words_per_row_ + second / 64] >> (second % 64)) & 1;
+    }
+
+    /// Calls f(second) for all bits set in the row of first in increasing order
+    template <typename F>
+    void for_each(state_t first, F &&f) const {
+        assert(first < num_states_);
+        for_each_bit(bits_.data() + first * words_per_row_,
+                     [&](size_t i) { f(static_cast<state_t>(i)); });
+    }
+
+    /// Returns the sum of counts[second] over all bits set in the row of first
+    template <typename T>
+    uint64_t masked_sum(state_t first, const T *counts) const noexcept {
+        assert(first < num_states_);
+        const uint64_t *row = bits_.data() + first * words_per_row_;
+
+        if constexpr (sizeof(T) == sizeof(uint64_t) && std::is_integral_v<T>) {
+            return masked_sum64(row, reinterpret_cast<const uint64_t *>(counts));
+        } else {
+            uint64_t sum = 0;
+            for_each_bit(row, [&](size_t i) { sum += counts[i]; });
+            return sum;
+        }
+    }
+
+private:
+    size_t num_states_{0};
+    size_t words_per_row_{0};
+    std::vector<uint64_t> bits_;
+
+    template <typename F>
+    void for_each_bit(const uint64_t *row, F &&f) const {
+        for (size_t w = 0; w < words_per_row_; ++w) {
+            for (auto word = row[w]; word; word &= word - 1)
+                f(64 * w + __builtin_ctzll(word));
+        }
+    }
+
+    uint64_t masked_sum64(const uint64_t *row, const uint64_t *counts) const noexcept {
+#if defined(__AVX512F__)
+        // masked loads suppress faults on inactive lanes, so we may run past num_states_
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t w = 0; w < words_per_row_; ++w) {
+            const auto word = row[w];
+            if (!word)
+                continue;
+
+            const auto *base = counts + 64 * w;
+            for (unsigned lane = 0; lane < 64; lane += 8) {
+                const auto mask = static_cast<__mmask8>(word >> lane);
+                if (mask)
+                    acc = _mm512_add_epi64(acc, _mm512_maskz_loadu_epi64(mask, base + lane));
+            }
+        }
+
+        // scalar horizontal add; GCC 12's _mm512_reduce_add_epi64 and _mm512_extracti64x4_epi64
+        // raise -Wmaybe-uninitialized in its own headers
+        alignas(64) uint64_t parts[8];
+        _mm512_store_si512(parts, acc);
+        return (parts[0] + parts[1]) + (parts[2] + parts[3]) + (parts[4] + parts[5])
+               + (parts[6] + parts[7]);
+
+#elif defined(__AVX2__)
+        const __m256i lane_bits = _mm256_set_epi64x(8, 4, 2, 1);
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t w = 0; w < words_per_row_; ++w) {
+            const auto word = row[w];
+            if (!word)
+                continue;
+
+            const auto *base = reinterpret_cast<const long long *>(counts + 64 * w);
+            for (unsigned lane = 0; lane < 64; lane += 4) {
+                const auto nibble = static_cast<long long>((word >> lane) & 0xf);
+                if (!nibble)
+                    continue;
+
+                // expand the four mask bits into lanes of all ones / all zeros
+                const __m256i mask = _mm256_cmpeq_epi64(
+                    _mm256_and_si256(_mm256_set1_epi64x(nibble), lane_bits), lane_bits);
+                acc = _mm256_add_epi64(acc, _mm256_maskload_epi64(base + lane, mask));
+            }
+        }
+
+        alignas(32) uint64_t parts[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(parts), acc);
+        return parts[0] + parts[1] + parts[2] + parts[3];
+
+#else
+        uint64_t sum = 0;
+        for_each_bit(row, [&](size_t i) { sum += counts[i]; });
+        return sum;
+#endif
+    }
+};
+
+} // namespace pps
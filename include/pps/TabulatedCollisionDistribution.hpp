@@ -0,0 +1,163 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <tlx/define/likely.hpp>
+
+#include <pps/CollisionDistribution.hpp>
+
+namespace pps {
+
+/**
+ * Draws from the same distribution as CollisionDisitribution (which remains the reference
+ * implementation), but replaces the root search of each draw by a table lookup.
+ *
+ * With g red balls, the probability that the first k draws are green is
+ *   P(X >= k) = prod_{i=1}^{k} (1 - (g + i) / n) = exp(-(H(g + k) - H(g)))
+ * for the cumulative hazard H(m) = sum_{i=1}^{m} -log(1 - i / n). Inverting the CDF with
+ * U = exp(-E) hence yields X = max{m : H(m) <= H(g) + E} - g, where E is exponential. In
+ * contrast to the quantiles, H does not depend on g, so a single table of H serves all numbers
+ * of red balls. Since H(m) ~ m^2 / 2n, we index a guide table by floor(sqrt(2n t)), which
+ * leaves O(1) candidates to scan.
+ *
+ * The table is grown on demand and covers m < kMaxTableSize; draws beyond (i.e. with g
+ * close to that limit or in the far tail) fall back to the root search of the reference.
+ */
+class TabulatedCollisionDistribution {
+public:
+    using value_type = CollisionDisitribution::value_type;
+
+    static constexpr size_t kMaxTableSize = size_t{1} << 20;
+    static constexpr size_t kMinTableSize = 1024;
+
+    explicit TabulatedCollisionDistribution(value_type n, value_type g = 0, value_type max_g = 0)
+        : n_(n), two_n_(2.0 * n),
+          max_m_(std::min<size_t>(kMaxTableSize, static_cast<size_t>(n / 2))),
+          reference_(n, g, max_g) {
+        hazard_.push_back(0.0);
+        guide_.push_back(0);
+        set_red(g);
+    }
+
+    void set_red(value_type g) {
+        assert(g <= n_);
+        g_ = g;
+        reference_is_current_ = false;
+    }
+
+    template <typename Gen>
+    value_type operator()(Gen &gen) {
+        return compute(unif_(gen));
+    }
+
+    /// Same as CollisionDisitribution::compute, i.e. returns the quantile of uniform
+    value_type compute(double uniform) {
+        assert(0 < uniform && uniform <= 1);
+        const auto target = -std::log(uniform);
+
+        if (TLX_LIKELY(static_cast<size_t>(g_) < hazard_.size())) {
+            const auto threshold = hazard_[g_] + target;
+            if (TLX_UNLIKELY(threshold >= hazard_.back()))
+                extend_table(threshold);
+
+            if (TLX_LIKELY(threshold < hazard_.back()))
+                return static_cast<value_type>(lookup(threshold)) - g_;
+        } else if (static_cast<size_t>(g_) <= max_m_) {
+            extend_table(target);
+            return compute(uniform);
+        }
+
+        fallbacks_++;
+        if (!reference_is_current_) {
+            reference_.set_red(g_);
+            reference_is_current_ = true;
+        }
+        return reference_.compute(uniform);
+    }
+
+    /// Number of draws that were answered by the root search of the reference
+    size_t num_fallbacks() const noexcept { return fallbacks_; }
+
+private:
+    value_type n_;
+    value_type g_{0};
+    double two_n_;
+    size_t max_m_;
+
+    std::vector<double> hazard_; //!< hazard_[m] = H(m) for the tabulated m
+    std::vector<uint32_t> guide_; //!< guide_[j] = max{m : H(m) <= j^2 / 2n}
+
+    CollisionDisitribution reference_;
+    bool reference_is_current_{false};
+    size_t fallbacks_{0};
+
+    // (a denormal lower bound would cost a microcode assist in each draw)
+    std::uniform_real_distribution<double> unif_{std::numeric_limits<double>::min(), 1.0};
+
+    /// Returns max{m : H(m) <= threshold} for threshold < hazard_.back()
+    size_t lookup(double threshold) const noexcept {
+        const auto j = static_cast<size_t>(std::sqrt(two_n_ * threshold));
+        auto m = static_cast<size_t>(guide_[std::min(j, guide_.size() - 1)]);
+
+        // the square root may round up; then we start one bucket too far
+        while (TLX_UNLIKELY(hazard_[m] > threshold))
+            --m;
+
+        while (hazard_[m + 1] <= threshold)
+            ++m;
+
+        return m;
+    }
+
+    /// Doubles the table until it exceeds threshold or reaches max_m_
+    void extend_table(double threshold) {
+        while (hazard_.back() <= threshold || hazard_.size() <= static_cast<size_t>(g_)) {
+            if (hazard_.size() > max_m_)
+                return;
+
+            const auto old_size = hazard_.size();
+            const auto new_size = std::min(max_m_ + 1, std::max(2 * old_size, kMinTableSize));
+
+            hazard_.reserve(new_size);
+            for (auto m = old_size; m < new_size; ++m)
+                hazard_.push_back(hazard_.back() - std::log1p(-static_cast<double>(m) / n_));
+
+            // all guide entries must stay below the last entry, so lookup can scan ahead
+            const auto max_j = static_cast<size_t>(std::sqrt(two_n_ * hazard_.back()));
+            size_t m = guide_.back();
+            for (auto j = guide_.size(); j <= max_j; ++j) {
+                const auto bound = static_cast<double>(j) * j / two_n_;
+                while (m + 1 < new_size && hazard_[m + 1] <= bound)
+                    ++m;
+                guide_.push_back(static_cast<uint32_t>(m));
+            }
+        }
+    }
+};
+
+} // namespace pps
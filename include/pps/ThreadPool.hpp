@@ -0,0 +1,121 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pps {
+
+/**
+ * Minimal fork-join pool with persistent workers. A call to run(f) executes
+ * f(0), ..., f(num_threads() - 1) concurrently, where f(0) is carried out by the
+ * calling thread, and returns once all invocations completed. Since the simulators
+ * hand out work once per epoch, we keep the threads alive instead of spawning
+ * them each time.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned num_threads) {
+        assert(num_threads > 0);
+        threads_.reserve(num_threads - 1);
+        for (unsigned i = 1; i < num_threads; ++i)
+            threads_.emplace_back(&ThreadPool::worker_main, this, i);
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::unique_lock lock(mutex_);
+            running_ = false;
+        }
+        cv_start_.notify_all();
+
+        for (auto &t : threads_)
+            t.join();
+    }
+
+    unsigned num_threads() const noexcept { return static_cast<unsigned>(threads_.size() + 1); }
+
+    template <typename F>
+    void run(F &&f) {
+        if (threads_.empty())
+            return f(0u);
+
+        {
+            std::unique_lock lock(mutex_);
+            job_ = std::ref(f);
+            num_pending_ = static_cast<unsigned>(threads_.size());
+            generation_++;
+        }
+        cv_start_.notify_all();
+
+        f(0u);
+
+        std::unique_lock lock(mutex_);
+        cv_done_.wait(lock, [&] { return !num_pending_; });
+        job_ = nullptr;
+    }
+
+private:
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_start_;
+    std::condition_variable cv_done_;
+
+    std::function<void(unsigned)> job_;
+    size_t generation_{0};
+    unsigned num_pending_{0};
+    bool running_{true};
+
+    void worker_main(unsigned thread_id) {
+        size_t last_generation = 0;
+
+        while (true) {
+            std::function<void(unsigned)> job;
+            {
+                std::unique_lock lock(mutex_);
+                cv_start_.wait(lock, [&] { return generation_ != last_generation || !running_; });
+                if (!running_)
+                    return;
+
+                last_generation = generation_;
+                job = job_;
+            }
+
+            job(thread_id);
+
+            {
+                std::unique_lock lock(mutex_);
+                if (!--num_pending_)
+                    cv_done_.notify_one();
+            }
+        }
+    }
+};
+
+} // namespace pps
@@ -28,8 +28,13 @@
 #include <sstream>
 #include <string>
 
-#include <sampling/hypergeometric_distribution.hpp>
+#include <sampling/multivariate_hypergeometric.hpp>
 #include <tlx/define.hpp>
+#include <urns/BoundedUniform.hpp>
+#include <urns/GuideTable.hpp>
+#include <urns/OccupiedColors.hpp>
+#include <urns/TouchedColors.hpp>
+#include <urns/Traits.hpp>
 
 namespace pps {
 
@@ -47,6 +52,12 @@ public:
     using storage_type = std::vector<value_type>;
     using const_iterator = typename storage_type::const_iterator;
 
+    //! Batch size for which get_random_balls / remove_random_balls are intended
+    static constexpr size_t kBatchedDraws = 16;
+
+    //! Below this number of colors, the linear scan is faster than the guide table
+    static constexpr size_t kMinColorsForGuideTable = 32;
+
     // construction
     WeightedUrn() = delete;
 
@@ -56,21 +67,43 @@ public:
      * its number must match the sum of all counts provided.
      */
     explicit WeightedUrn(const storage_type &freqs)
-        : balls_with_color_(freqs), number_of_balls_(count_balls()) {}
+        : balls_with_color_(freqs), number_of_balls_(count_balls()), touched_(freqs.size()),
+          occupied_(freqs.size()) {
+        touched_.touch_all();
+        occupied_.assign(data());
+    }
 
     WeightedUrn(const storage_type &freqs, value_type num_of_balls)
-        : balls_with_color_(freqs), number_of_balls_(num_of_balls) {}
+        : balls_with_color_(freqs), number_of_balls_(num_of_balls), touched_(freqs.size()),
+          occupied_(freqs.size()) {
+        touched_.touch_all();
+        occupied_.assign(data());
+    }
 
     explicit WeightedUrn(storage_type &&freqs)
-        : balls_with_color_(std::move(freqs)), number_of_balls_(count_balls()) {}
+        : balls_with_color_(std::move(freqs)), number_of_balls_(count_balls()),
+          touched_(balls_with_color_.size()), occupied_(balls_with_color_.size()) {
+        touched_.touch_all();
+        occupied_.assign(data());
+    }
 
     WeightedUrn(storage_type &&freqs, value_type num_of_balls)
-        : balls_with_color_(std::move(freqs)), number_of_balls_(num_of_balls) {}
+        : balls_with_color_(std::move(freqs)), number_of_balls_(num_of_balls),
+          touched_(balls_with_color_.size()), occupied_(balls_with_color_.size()) {
+        touched_.touch_all();
+        occupied_.assign(data());
+    }
 
     /// Construct a uniformly filled urn
     explicit WeightedUrn(color_type num_of_colors, value_type balls_each = 0)
         : balls_with_color_(num_of_colors, balls_each),
-          number_of_balls_(num_of_colors * balls_each) {}
+          number_of_balls_(num_of_colors * balls_each), touched_(num_of_colors),
+          occupied_(num_of_colors) {
+        if (balls_each) {
+            touched_.touch_all();
+            occupied_.assign(data());
+        }
+    }
 
     WeightedUrn(const WeightedUrn &) = default;
     WeightedUrn(WeightedUrn &&) = default;
@@ -89,20 +122,39 @@ public:
 
     size_t number_of_colors() const noexcept { return balls_with_color_.size(); }
 
+    //! Contiguous array of number_of_colors() counts,
+    //! i.e. data()[i] == number_of_balls_with_color(i)
+    const value_type *data() const noexcept { return balls_with_color_.data(); }
+
+    //! Colors with at least one ball; iterating them visits the colors in increasing order
+    const urns::OccupiedColors &occupied_colors() const noexcept { return occupied_; }
+
     // manipulators
     //! Adds n balls of color col
     void add_balls(color_type col, value_type n = 1) {
         assert(col < number_of_colors());
+        const auto old_num = balls_with_color_[col];
         balls_with_color_[col] += n;
         number_of_balls_ += n;
+        touched_.touch(col);
+        occupied_.update(col, old_num, balls_with_color_[col]);
+
+        // the guide table stays valid as long as no color exceeds its count at build time;
+        // otherwise we wait for the next add_urn before we spend another rebuild
+        if (guide_.valid() && !guide_.covers(col, balls_with_color_[col])) {
+            guide_.invalidate();
+            guide_buildable_ = false;
+        }
     }
 
     //! Removes n balls of color col
     void remove_balls(color_type col, value_type n = 1) {
         assert(col < number_of_colors());
         assert(n <= balls_with_color_[col]);
+        const auto old_num = balls_with_color_[col];
         balls_with_color_[col] -= n;
         number_of_balls_ -= n;
+        occupied_.update(col, old_num, balls_with_color_[col]);
     }
 
     // sample single ball
@@ -112,18 +164,9 @@ public:
     template <typename Gen>
     value_type get_random_ball(Gen &gen) const {
         assert(number_of_balls() > 0);
-        std::uniform_int_distribution<size_t> distr(0, number_of_balls() - 1);
-
-        auto variate = distr(gen);
-        auto it = balls_with_color_.cbegin();
-
-        while (*it <= variate) {
-            variate -= *it;
-            ++it;
-            assert(it != balls_with_color_.cend());
-        }
-
-        return std::distance(balls_with_color_.cbegin(), it);
+        if (guide_.valid())
+            return guide_.sample(gen, balls_with_color_.data());
+        return get_random_ball_linear(gen);
     }
 
     //! Same as get_color_of_random(..) but also removes the ball from the urn
@@ -132,12 +175,37 @@ public:
     value_type remove_random_ball(Gen &gen) {
         assert(number_of_balls() > 0);
 
+        // rebuild once half of the balls covered by the table are gone (i.e. the
+        // expected number of rejections exceeds one)
+        if (TLX_UNLIKELY(guide_enabled_ && guide_buildable_ &&
+                         (!guide_.valid() || 2 * number_of_balls_ < guide_.number_of_balls())))
+            guide_.build(balls_with_color_.data(), number_of_colors(), number_of_balls_);
+
         const auto color = get_random_ball(gen);
-        --balls_with_color_[color];
+        if (!--balls_with_color_[color])
+            occupied_.erase(color);
         --number_of_balls_;
         return color;
     }
 
+    //! Draws num balls with replacement and stores their colors in colors[0, num).
+    //! Other than in TreeUrn, interleaving several linear scans does not pay off:
+    //! the counts are scanned sequentially (i.e. prefetched by the hardware) anyhow, and a
+    //! lockstep scan has to track its active walks for each color. So we draw one by one.
+    template <typename Gen>
+    void get_random_balls(Gen &gen, color_type *colors, size_t num) const {
+        for (size_t i = 0; i < num; ++i)
+            colors[i] = get_random_ball(gen);
+    }
+
+    //! Same as num calls to remove_random_ball
+    template <typename Gen>
+    void remove_random_balls(Gen &gen, color_type *colors, size_t num) {
+        assert(num <= number_of_balls_);
+        for (size_t i = 0; i < num; ++i)
+            colors[i] = remove_random_ball(gen);
+    }
+
     // sample frequencies
     template <bool CallOnEmpty, typename Gen, typename Callback>
     void sample_without_replacement(const value_type num_of_samples, Gen &gen,
@@ -145,37 +213,28 @@ public:
         if (TLX_UNLIKELY(!number_of_balls() || !num_of_samples))
             return;
 
-        sampling::hypergeometric_distribution<Gen, value_type> hpd(gen);
-
-        auto left_to_sample = num_of_samples;
-        auto unconsidered_balls = static_cast<double>(number_of_balls());
-
-        auto it_from = balls_with_color_.cbegin();
+        sampling::multivariate_hypergeometric<Gen, value_type> mvh(gen);
+        auto split = mvh.start(number_of_balls(), num_of_samples);
 
-        while (left_to_sample) {
-            assert(it_from != balls_with_color_.cend());
-            const auto balls_with_color = *it_from;
-            unconsidered_balls -= balls_with_color;
-            const auto num_selected = [&]() -> size_t {
-                if (!balls_with_color)
-                    return 0;
+        // unless we have to report empty colors, we skip empty ones if there are many; as cb
+        // may remove the balls of the current color, we advance based on the color index
+        const bool skip_empty = !CallOnEmpty && 4 * occupied_.size() < number_of_colors();
+        auto next_color = [&](color_type col) {
+            return skip_empty ? occupied_.find_next(col + 1) : col + 1;
+        };
 
-                if (!unconsidered_balls)
-                    return std::min(left_to_sample, balls_with_color);
-
-                return hpd(balls_with_color, unconsidered_balls, left_to_sample);
-            }();
+        color_type col = skip_empty ? occupied_.find_next(0) : 0;
+        for (; split.left_to_sample(); col = next_color(col)) {
+            assert(col < number_of_colors());
+            const auto num_selected = split(balls_with_color_[col]);
 
             if (CallOnEmpty || num_selected)
-                cb(static_cast<color_type>(it_from - balls_with_color_.cbegin()), num_selected);
-
-            left_to_sample -= num_selected;
-            it_from++;
+                cb(static_cast<color_type>(col), num_selected);
         }
 
         if (CallOnEmpty) {
-            for (; it_from != balls_with_color_.cend(); ++it_from)
-                cb(static_cast<color_type>(it_from - balls_with_color_.cbegin()), 0);
+            for (; col < number_of_colors(); ++col)
+                cb(static_cast<color_type>(col), 0);
         }
     }
 
@@ -216,14 +275,31 @@ public:
     bool operator!=(const WeightedUrn &o) const { return balls_with_color_ != o.balls_with_color_; }
 
     WeightedUrn &operator+=(const WeightedUrn &o) {
-        apply_elementwise(balls_with_color_, o.balls_with_color_, std::plus<value_type>());
+        assert(o.number_of_colors() == number_of_colors());
+        if (o.touched_.all()) {
+            apply_elementwise(balls_with_color_, o.balls_with_color_, std::plus<value_type>());
+            touched_.touch_all();
+            occupied_.assign(data());
+        } else {
+            // only colors touched in o may contain balls
+            for (auto col : o.touched_.listed()) {
+                const auto old_num = balls_with_color_[col];
+                balls_with_color_[col] += o.balls_with_color_[col];
+                touched_.touch(col);
+                occupied_.update(col, old_num, balls_with_color_[col]);
+            }
+        }
+
         number_of_balls_ += o.number_of_balls();
+        guide_.invalidate();
+        guide_buildable_ = true;
         return *this;
     }
 
     WeightedUrn &operator-=(const WeightedUrn &o) {
         apply_elementwise(balls_with_color_, o.balls_with_color_, std::minus<value_type>());
         number_of_balls_ -= o.number_of_balls();
+        occupied_.assign(data());
         return *this;
     }
 
@@ -241,12 +317,45 @@ public:
 
     void add_urn(const WeightedUrn &o) { *this += o; }
 
+    /**
+     * Accelerate single draws with a guide table (see urns::GuideTable), which lets a draw
+     * jump next to its color and scan O(1) colors in expectation.
+     *
+     * The table is built lazily by the first remove_random_ball() after an add_urn() (i.e.
+     * once per epoch of AsyncBatchSimulator) and costs Theta(m) time. Afterwards, we
+     * keep using it while balls are removed, and rebuild it once half of the balls are gone.
+     * An insertion exceeding the count of its color at build time invalidates the table
+     * until the next add_urn().
+     *
+     * Has no effect if there are less than kMinColorsForGuideTable colors.
+     */
+    void enable_guide_table(bool enable = true) {
+        guide_enabled_ = enable && number_of_colors() >= kMinColorsForGuideTable;
+        guide_.invalidate();
+        guide_buildable_ = true;
+        if (!guide_enabled_)
+            guide_.release();
+    }
+
+    bool guide_table_enabled() const noexcept { return guide_enabled_; }
+
     // helpers
     bool empty() const noexcept { return !number_of_balls(); }
 
+    //! Takes time proportional to the number of colors touched since the last clear()
     void clear() noexcept {
         number_of_balls_ = 0;
-        std::fill(balls_with_color_.begin(), balls_with_color_.end(), 0);
+        if (touched_.all()) {
+            std::fill(balls_with_color_.begin(), balls_with_color_.end(), 0);
+            occupied_.clear();
+        } else {
+            for (auto col : touched_.listed())
+                balls_with_color_[col] = 0;
+            occupied_.clear(touched_.listed());
+        }
+        touched_.reset();
+        guide_.invalidate();
+        guide_buildable_ = true;
     }
 
     std::vector<double> relative_frequencies() const {
@@ -264,11 +373,8 @@ public:
     std::string to_string() {
         std::stringstream ss;
         ss << '[';
-        color_type i = 0;
         bool sep = false;
-        for (size_t i = 0; i < balls_with_color_.size(); ++i) {
-            if (!balls_with_color_[i])
-                continue;
+        for (auto i : occupied_) {
             if (sep)
                 ss << ", ";
             ss << i << ':' << balls_with_color_[i];
@@ -281,6 +387,29 @@ public:
 private:
     storage_type balls_with_color_;
     value_type number_of_balls_;
+    urns::TouchedColors touched_; //!< superset of the colors with balls
+    urns::OccupiedColors occupied_;
+
+    // guide table, see enable_guide_table()
+    bool guide_enabled_{false};
+    bool guide_buildable_{true}; //!< false if an insertion invalidated the table since add_urn
+    urns::GuideTable<value_type> guide_;
+
+    template <typename Gen>
+    value_type get_random_ball_linear(Gen &gen) const {
+        urns::UniformInt<size_t> distr(0, number_of_balls() - 1);
+
+        auto variate = distr(gen);
+        auto it = balls_with_color_.cbegin();
+
+        while (*it <= variate) {
+            variate -= *it;
+            ++it;
+            assert(it != balls_with_color_.cend());
+        }
+
+        return std::distance(balls_with_color_.cbegin(), it);
+    }
 
     value_type count_balls() const noexcept {
         return std::accumulate(balls_with_color_.cbegin(), balls_with_color_.cend(), value_type{0});
@@ -297,3 +426,17 @@ private:
 };
 
 } // namespace pps
+
+namespace urns::traits {
+
+template <>
+struct has_batched_draws<pps::WeightedUrn> {
+    static constexpr bool value = true;
+};
+
+template <>
+struct has_occupied_colors<pps::WeightedUrn> {
+    static constexpr bool value = true;
+};
+
+} // namespace urns::traits
@@ -19,6 +19,7 @@
  */
 #pragma once
 #include <pps/Protocols.hpp>
+#include <urns/Traits.hpp>
 
 // copied from YAPPS
 namespace yapps {
@@ -83,29 +84,33 @@ public:
 
     template <typename Agents>
     yapps::Clock compute_max_gap(const Agents &agents, size_t threshold) const noexcept {
-        auto is_empty = [&](unsigned digit) {
-            return agents.number_of_balls_with_color(encode({digit, false}))
-                       + agents.number_of_balls_with_color(encode({digit, true}))
-                   <= threshold;
-        };
-
-        // find the long contigious of gap (i.e. a digit without agents)
-        yapps::Clock max_gap = 0;
-        for (yapps::Clock i = 0; i < digits_on_clock(); ++i) {
-            if (!is_empty(i))
-                continue;
-
-            yapps::Clock gap_length = 1;
-            for (; gap_length < digits_on_clock() - 1; ++gap_length) {
-                auto digit = (i + gap_length) % digits_on_clock();
-                if (!is_empty(digit))
-                    break;
+        if constexpr (urns::traits::has_occupied_colors_v<Agents>) {
+            return compute_max_gap_occupied(agents, threshold);
+        } else {
+            auto is_empty = [&](unsigned digit) {
+                return agents.number_of_balls_with_color(encode({digit, false}))
+                           + agents.number_of_balls_with_color(encode({digit, true}))
+                       <= threshold;
+            };
+
+            // find the long contigious of gap (i.e. a digit without agents)
+            yapps::Clock max_gap = 0;
+            for (yapps::Clock i = 0; i < digits_on_clock(); ++i) {
+                if (!is_empty(i))
+                    continue;
+
+                yapps::Clock gap_length = 1;
+                for (; gap_length < digits_on_clock() - 1; ++gap_length) {
+                    auto digit = (i + gap_length) % digits_on_clock();
+                    if (!is_empty(digit))
+                        break;
+                }
+
+                max_gap = std::max(gap_length, max_gap);
             }
 
-            max_gap = std::max(gap_length, max_gap);
+            return max_gap;
         }
-
-        return max_gap;
     }
 
     template <typename Agents>
@@ -122,4 +127,52 @@ public:
 
 private:
     yapps::Clock digits_on_clock_; // digits on clock
+
+    // same as compute_max_gap, but only visits the occupied states: we merge the unmarked and
+    // marked states by digit and measure the gaps between consecutive non-empty digits
+    template <typename Agents>
+    yapps::Clock compute_max_gap_occupied(const Agents &agents, size_t threshold) const noexcept {
+        const auto m = digits_on_clock();
+        const auto &occupied = agents.occupied_colors();
+
+        size_t unmarked = occupied.find_next(encode({0, false}));
+        size_t marked = occupied.find_next(encode({0, true}));
+
+        yapps::Clock first_digit = m;
+        yapps::Clock last_digit = m;
+        yapps::Clock max_gap = 0;
+        while (true) {
+            const auto digit = static_cast<yapps::Clock>(
+                std::min<size_t>(unmarked < m ? unmarked : m, marked < 2 * m ? marked - m : m));
+            if (digit == m)
+                break;
+
+            size_t agents_with_digit = 0;
+            if (unmarked == digit) {
+                agents_with_digit += agents.number_of_balls_with_color(unmarked);
+                unmarked = occupied.find_next(unmarked + 1);
+            }
+            if (marked == digit + m) {
+                agents_with_digit += agents.number_of_balls_with_color(marked);
+                marked = occupied.find_next(marked + 1);
+            }
+
+            if (agents_with_digit <= threshold)
+                continue;
+
+            if (last_digit == m) {
+                first_digit = digit;
+            } else {
+                max_gap = std::max(max_gap, digit - last_digit - 1);
+            }
+            last_digit = digit;
+        }
+
+        if (last_digit == m)
+            return m - 1;
+
+        // gap wrapping around the end of the clock
+        max_gap = std::max(max_gap, first_digit + m - last_digit - 1);
+        return std::min(max_gap, m - 1);
+    }
 };
@@ -0,0 +1,316 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+#include <tlx/define/likely.hpp>
+#include <tlx/logger.hpp>
+
+#include <sampling/hypergeometric_distribution.hpp>
+
+namespace sampling {
+
+/**
+ * log(k!) from a table for small k and from Stirling's series otherwise. Both are accurate
+ * to about one ulp, but avoid the argument reduction and polynomial evaluation of std::lgamma.
+ */
+class log_factorial {
+public:
+    static constexpr int64_t kTableSize = 1024;
+
+    static double get(int64_t k) noexcept {
+        assert(k >= 0);
+        if (TLX_LIKELY(k < kTableSize))
+            return table()[k];
+
+        // log k! = (k + 1/2) log k - k + log(2 pi) / 2 + 1/(12k) - 1/(360k^3) + O(k^-5)
+        constexpr double kHalfLog2Pi = 0.91893853320467274178;
+        const auto x = static_cast<double>(k);
+        const auto inv = 1.0 / x;
+        const auto inv2 = inv * inv;
+        return (x + 0.5) * std::log(x) - x + kHalfLog2Pi +
+               inv * (1.0 / 12 - inv2 * (1.0 / 360 - inv2 / 1260));
+    }
+
+private:
+    using table_type = std::array<double, kTableSize>;
+
+    static const table_type &table() noexcept {
+        static const table_type table = [] {
+            table_type t;
+            for (int64_t k = 0; k < kTableSize; ++k)
+                t[k] = std::lgamma(k + 1.0);
+            return t;
+        }();
+        return table;
+    }
+};
+
+/**
+ * Drop-in replacement for hypergeometric_distribution, which is on the hot path of the batch
+ * simulator (and the urns' sample_without_replacement). It differs in three ways:
+ *
+ *  - Log-factorials are taken from log_factorial instead of computed with std::lgamma.
+ *  - If the mean is small, we invert the CDF starting at zero (one uniform and a few
+ *    multiplications per unit of the result), rather than drawing one uniform per sample.
+ *  - Otherwise, we use rejection in the spirit of H2PE: the hat is constant around the mode
+ *    and decays geometrically in both tails. As the pmf is log-concave, the ratio of the
+ *    pmf at the box boundaries bounds the tails, so the setup only needs the log-pmf at the
+ *    mode. Inside the box, the same ratios yield a linear squeeze that accepts about half of
+ *    the draws without evaluating the pmf.
+ *
+ * If the mode exceeds the table of log_factorial, each pmf evaluation of the rejection needs
+ * four Stirling series, and the reference's HRUA is at least as fast (e.g. for large samples
+ * from huge populations); we then defer to hypergeometric_distribution.
+ *
+ * If max_binomial_error > 0, we draw from Binomial(sample, good / (good + bad)) instead
+ * whenever its total variation distance to the hypergeometric distribution, which is at most
+ * (sample - 1) / (good + bad - 1), is below max_binomial_error. The binomial uses the same
+ * two methods (in the spirit of BTPE), but its pmf needs only two log-factorials.
+ */
+template <typename PRNG, typename int_t = int64_t, typename fp_t = double>
+class fast_hypergeometric_distribution {
+public:
+    using result_type = int_t;
+    using real_type = fp_t;
+
+    explicit fast_hypergeometric_distribution(PRNG &gen, fp_t max_binomial_error = 0.0)
+        : gen_(gen), max_binomial_error_(max_binomial_error), reference_(gen) {}
+
+    int_t operator()(int_t good, int_t bad, int_t sample) {
+        if (sample < 1) {
+            sLOG1 << "hypergeometric distribution error: sample < 1:" << sample;
+            return static_cast<int_t>(-1);
+        }
+        if (good + bad < sample) {
+            sLOG1 << "hypergeometric distribution error: good + bad < sample:"
+                  << "good:" << good << "bad:" << bad << "sample:" << sample;
+            return static_cast<int_t>(-1);
+        }
+
+        const auto igood = static_cast<int64_t>(good);
+        const auto ibad = static_cast<int64_t>(bad);
+        const auto isample = static_cast<int64_t>(sample);
+
+        // by symmetry, we only need to sample at most half of the population and count the
+        // smaller of both colors; then the support is [0, min(m, min_good_bad)]
+        const auto popsize = igood + ibad;
+        const auto min_good_bad = std::min(igood, ibad);
+        const auto m = std::min(isample, popsize - isample);
+
+        int64_t z;
+        if (!min_good_bad || !m) {
+            z = 0;
+        } else if (m - 1 <= max_binomial_error_ * (popsize - 1)) {
+            z = draw(binomial_model(m, static_cast<fp_t>(min_good_bad) / popsize));
+        } else {
+            const hypergeometric_model model(popsize, min_good_bad, m);
+            if (model.mode() >= log_factorial::kTableSize)
+                return reference_(good, bad, sample);
+
+            z = draw(model);
+        }
+
+        if (igood > ibad)
+            z = m - z;
+
+        if (m < isample)
+            z = igood - z;
+
+        return static_cast<int_t>(z);
+    }
+
+private:
+    // inversion is used for means below, rejection above
+    static constexpr fp_t kMaxInversionMean = 12.0;
+
+    /// Counts the balls of a color with min_good balls among m drawn without replacement
+    struct hypergeometric_model {
+        int64_t popsize, min_good, m;
+
+        hypergeometric_model(int64_t popsize, int64_t min_good, int64_t m)
+            : popsize(popsize), min_good(min_good), m(m) {}
+
+        int64_t max_value() const noexcept { return std::min(m, min_good); }
+
+        fp_t mean() const noexcept { return static_cast<fp_t>(m) * min_good / popsize; }
+
+        fp_t variance() const noexcept {
+            const auto p = static_cast<fp_t>(min_good) / popsize;
+            return mean() * (1.0 - p) * (popsize - m) / (popsize - 1);
+        }
+
+        int64_t mode() const noexcept {
+            return static_cast<int64_t>(static_cast<fp_t>(m + 1) * (min_good + 1) / (popsize + 2));
+        }
+
+        /// log of the pmf at k up to a constant (which cancels in all uses)
+        fp_t log_weight(int64_t k) const noexcept {
+            return -(log_factorial::get(k) + log_factorial::get(min_good - k) +
+                     log_factorial::get(m - k) + log_factorial::get(popsize - min_good - m + k));
+        }
+
+        fp_t log_pmf_at_zero() const noexcept {
+            return log_factorial::get(popsize - min_good) + log_factorial::get(popsize - m) -
+                   log_factorial::get(popsize) - log_factorial::get(popsize - min_good - m);
+        }
+
+        /// pmf(k + 1) / pmf(k)
+        fp_t ratio(int64_t k) const noexcept {
+            return static_cast<fp_t>(min_good - k) * (m - k) /
+                   (static_cast<fp_t>(k + 1) * (popsize - min_good - m + k + 1));
+        }
+    };
+
+    /// Binomial(m, p) with p <= 1/2
+    struct binomial_model {
+        int64_t m;
+        fp_t p, odds, log_odds;
+
+        binomial_model(int64_t m, fp_t p)
+            : m(m), p(p), odds(p / (1.0 - p)), log_odds(std::log(odds)) {}
+
+        int64_t max_value() const noexcept { return m; }
+
+        fp_t mean() const noexcept { return m * p; }
+
+        fp_t variance() const noexcept { return m * p * (1.0 - p); }
+
+        int64_t mode() const noexcept { return static_cast<int64_t>((m + 1) * p); }
+
+        fp_t log_weight(int64_t k) const noexcept {
+            return k * log_odds - (log_factorial::get(k) + log_factorial::get(m - k));
+        }
+
+        fp_t log_pmf_at_zero() const noexcept { return m * std::log1p(-p); }
+
+        fp_t ratio(int64_t k) const noexcept {
+            return static_cast<fp_t>(m - k) / (k + 1) * odds;
+        }
+    };
+
+    template <typename Model>
+    int64_t draw(const Model &model) {
+        if (model.mean() < kMaxInversionMean)
+            return inversion(model);
+
+        return rejection(model);
+    }
+
+    template <typename Model>
+    int64_t inversion(const Model &model) {
+        const auto max_value = model.max_value();
+        const auto pmf_at_zero = std::exp(model.log_pmf_at_zero());
+
+        while (true) {
+            auto u = uniform_();
+            auto pmf = pmf_at_zero;
+            for (int64_t k = 0; k <= max_value && pmf > 0; ++k) {
+                if (u <= pmf)
+                    return k;
+                u -= pmf;
+                pmf *= model.ratio(k);
+            }
+            // rounding errors accumulated to more than u; rare enough to simply retry
+        }
+    }
+
+    template <typename Model>
+    int64_t rejection(const Model &model) {
+        const auto max_value = model.max_value();
+        const auto mode = model.mode();
+        const auto log_weight_mode = model.log_weight(mode);
+
+        // box [left, right] around the mode of roughly one standard deviation to each side;
+        // this minimizes the area of the hat below for a normal distribution
+        const auto half_width = static_cast<int64_t>(std::sqrt(model.variance()) + 0.5) + 1;
+        const auto left = std::max<int64_t>(0, mode - half_width);
+        const auto right = std::min(max_value, mode + half_width);
+
+        // log-concavity gives pmf(left - j) <= pmf(mode) / left_ratio^j for the left tail and
+        // pmf(k) >= pmf(mode) / left_ratio^(mode - k) >= pmf(mode) (1 - (mode - k) (left_ratio
+        // - 1)) inside the box; analogously on the right. If the box reaches the end of the
+        // support, there is no tail and we take the squeeze from the last ratio in the box.
+        const auto left_ratio = model.ratio(std::max<int64_t>(left, 1) - 1);
+        const auto right_ratio = model.ratio(std::min(right, max_value - 1));
+        const auto left_slope = left_ratio - 1.0;
+        const auto right_slope = (1.0 - right_ratio) / right_ratio;
+
+        const auto box_area = static_cast<fp_t>(right - left + 1);
+        const auto left_area = left ? 1.0 / left_slope : 0.0;
+        const auto right_area = (right < max_value) ? right_ratio / (1.0 - right_ratio) : 0.0;
+        const auto total_area = box_area + left_area + right_area;
+
+        while (true) {
+            const auto u = uniform_() * total_area;
+            const auto v = uniform_();
+
+            int64_t k;
+            fp_t log_hat; // log(hat(k) / pmf(mode))
+            if (u < box_area) {
+                k = left + static_cast<int64_t>(u);
+                log_hat = 0.0;
+
+                const auto squeeze =
+                    (k < mode) ? (mode - k) * left_slope : (k - mode) * right_slope;
+                if (v <= 1.0 - squeeze)
+                    return k;
+
+            } else if (u < box_area + left_area) {
+                // geometric number of steps beyond the box
+                const auto log_ratio = std::log(left_ratio);
+                const auto j = 1.0 + std::floor(-std::log((u - box_area) / left_area) / log_ratio);
+                if (j > left)
+                    continue;
+                k = left - static_cast<int64_t>(j);
+                log_hat = -j * log_ratio;
+
+            } else {
+                const auto log_ratio = -std::log(right_ratio);
+                const auto j = 1.0 + std::floor(
+                                         -std::log((u - box_area - left_area) / right_area) /
+                                         log_ratio);
+                if (j > max_value - right)
+                    continue;
+                k = right + static_cast<int64_t>(j);
+                log_hat = -j * log_ratio;
+            }
+
+            if (std::log(v) + log_hat <= model.log_weight(k) - log_weight_mode)
+                return k;
+        }
+    }
+
+    // Data members:
+    PRNG &gen_;
+    fp_t max_binomial_error_;
+    std::uniform_real_distribution<double> real_;
+    hypergeometric_distribution<PRNG, int_t, fp_t> reference_;
+
+    double uniform_() { return real_(gen_); }
+};
+
+} // namespace sampling
@@ -0,0 +1,150 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <random>
+
+#include <sampling/fast_hypergeometric_distribution.hpp>
+
+namespace sampling {
+
+/**
+ * Multivariate hypergeometric sampling by conditional splitting: the number of sampled balls
+ * of cell i is drawn from the hypergeometric distribution of the balls in cell i against
+ * those of the cells after it, given the samples not assigned to the cells before it.
+ *
+ * Besides the span interface, start() returns a cursor that is fed the cells one at a
+ * time; this allows callers to skip empty cells, to stop early, or to act on each cell
+ * before the next one is drawn.
+ *
+ * If the cell, its complement, or the sample is tiny, we do not call the univariate sampler
+ * but decide each of these few balls with a Bernoulli trial (conditioned on the previous
+ * ones), which is exact and takes one uniform per trial.
+ */
+template <typename PRNG, typename int_t = int64_t>
+class multivariate_hypergeometric {
+public:
+    //! Largest number of trials on the Bernoulli fast path
+    static constexpr int_t kMaxTrials = 6;
+
+    explicit multivariate_hypergeometric(PRNG &gen, double max_binomial_error = 0.0)
+        : gen_(gen), hpd_(gen, max_binomial_error) {}
+
+    /// Number of sampled balls of a cell with count balls if sample balls are drawn
+    /// without replacement from count + rest balls
+    int_t split(int_t count, int_t rest, int_t sample) {
+        assert(sample <= count + rest);
+
+        if (!count || !sample)
+            return 0;
+
+        if (!rest)
+            return std::min(sample, count);
+
+        // the hypergeometric distribution is symmetric in count and sample; decide
+        // min(count, rest, sample) balls one after another
+        const auto trials = std::min(std::min(count, rest), sample);
+        if (trials <= kMaxTrials) {
+            auto population = static_cast<double>(count + rest);
+
+            if (trials == sample || trials == count) {
+                // sampled balls (or the cell's balls), each hits the cell (or the sample)
+                auto hits = int_t{0};
+                auto other = (trials == sample) ? count : sample;
+                for (int_t i = 0; i < trials; ++i, population -= 1.0) {
+                    const bool hit = uniform_() * population < static_cast<double>(other - hits);
+                    hits += hit;
+                }
+                return hits;
+            }
+
+            // the rest is tiny; count the sampled balls outside the cell
+            auto hits = int_t{0};
+            for (int_t i = 0; i < trials; ++i, population -= 1.0) {
+                const bool hit = uniform_() * population < static_cast<double>(sample - hits);
+                hits += hit;
+            }
+            return sample - hits;
+        }
+
+        return hpd_(count, rest, sample);
+    }
+
+    /// Draws sample balls without replacement from cells with counts[0..num_cells) balls and
+    /// stores the number of sampled balls of cell i in out[i]
+    void operator()(const int_t *counts, size_t num_cells, int_t sample, int_t *out) {
+        // separate pass to keep the sums vectorizable
+        int_t total = 0;
+        for (size_t i = 0; i < num_cells; ++i)
+            total += counts[i];
+
+        assert(sample <= total);
+
+        size_t i = 0;
+        for (; i < num_cells && sample; ++i) {
+            total -= counts[i];
+            out[i] = split(counts[i], total, sample);
+            sample -= out[i];
+        }
+
+        std::fill(out + i, out + num_cells, int_t{0});
+    }
+
+    /// Cursor over the cells of a multivariate sample of sample balls among total balls
+    class sequence {
+    public:
+        sequence(multivariate_hypergeometric &mvh, int_t total, int_t sample)
+            : mvh_(mvh), unconsidered_(total), left_to_sample_(sample) {
+            assert(sample <= total);
+        }
+
+        /// Number of sampled balls in the next cell, which has count balls
+        int_t operator()(int_t count) {
+            assert(count <= unconsidered_);
+            unconsidered_ -= count;
+            const auto selected = mvh_.split(count, unconsidered_, left_to_sample_);
+            left_to_sample_ -= selected;
+            return selected;
+        }
+
+        int_t left_to_sample() const noexcept { return left_to_sample_; }
+
+        int_t unconsidered() const noexcept { return unconsidered_; }
+
+    private:
+        multivariate_hypergeometric &mvh_;
+        int_t unconsidered_;
+        int_t left_to_sample_;
+    };
+
+    sequence start(int_t total, int_t sample) { return sequence(*this, total, sample); }
+
+private:
+    PRNG &gen_;
+    fast_hypergeometric_distribution<PRNG, int_t> hpd_;
+    std::uniform_real_distribution<double> real_;
+
+    double uniform_() { return real_(gen_); }
+};
+
+} // namespace sampling
@@ -0,0 +1,476 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <sampling/multivariate_hypergeometric.hpp>
+#include <tlx/define/likely.hpp>
+#include <urns/AliasUrnSimple.hpp>
+#include <urns/BoundedUniform.hpp>
+#include <urns/GuideTable.hpp>
+#include <urns/TouchedColors.hpp>
+#include <urns/TreeUrn.hpp>
+
+namespace urns {
+
+/**
+ * Urn that migrates between several representations at runtime, so we do not have to
+ * pick LinearUrn, TreeUrn, AliasUrnSimple, or a guide table up front.
+ *
+ * The counts are always stored in a plain array; it suffices for the Linear representation
+ * and is the input of the GuideTable. In the Tree and Alias representations, a TreeUrn or
+ * AliasUrnSimple mirrors the counts and serves the draws.
+ *
+ * Every kMinWindow (at least 4 * number_of_colors()) operations, we estimate the costs of
+ * the last window in each representation from the numbers of draws, single updates, and
+ * bulk operations, the expected length of a linear scan (which is short iff the balls are
+ * concentrated in few low colors), and the rate of alias table rebuilds. We migrate if
+ * another representation is estimated to be at least 25% cheaper. As the migration takes
+ * O(number_of_colors()) time, its costs are amortized by the window.
+ *
+ * @warning Copies start in the Linear representation; copy assignment is not supported.
+ */
+class AdaptiveUrn {
+public:
+    using value_type = int64_t;
+    using color_type = size_t;
+
+    enum class Representation { Linear, Guide, Tree, Alias };
+
+    //! Below this number of colors, we always scan linearly
+    static constexpr size_t kMinColorsToAdapt = 16;
+
+    //! Minimum number of operations between two decisions
+    static constexpr size_t kMinWindow = 4096;
+
+    explicit AdaptiveUrn(color_type number_of_colors)
+        : balls_with_color_(number_of_colors, 0), touched_(number_of_colors),
+          tree_(number_of_colors), alias_(number_of_colors),
+          window_(std::max(kMinWindow, 4 * number_of_colors)) {
+        assert(number_of_colors > 0);
+    }
+
+    AdaptiveUrn(const AdaptiveUrn &other) : AdaptiveUrn(other.number_of_colors()) {
+        add_urn(other);
+    }
+
+    AdaptiveUrn(AdaptiveUrn &&) = default;
+    AdaptiveUrn &operator=(const AdaptiveUrn &) = delete;
+    AdaptiveUrn &operator=(AdaptiveUrn &&) = default;
+
+    // accessors
+    value_type number_of_balls() const noexcept { return number_of_balls_; }
+
+    value_type number_of_balls_with_color(color_type col) const noexcept {
+        assert(col < number_of_colors());
+        return balls_with_color_[col];
+    }
+
+    color_type number_of_colors() const noexcept { return balls_with_color_.size(); }
+
+    bool empty() const noexcept { return !number_of_balls(); }
+
+    //! Contiguous array of number_of_colors() counts,
+    //! i.e. data()[i] == number_of_balls_with_color(i)
+    const value_type *data() const noexcept { return balls_with_color_.data(); }
+
+    Representation representation() const noexcept { return representation_; }
+
+    //! Migrates to the given representation in time O(number_of_colors()); the urn may
+    //! still move on once the current window ends
+    void convert_to(Representation target) {
+        if (target != representation_)
+            migrate(target);
+    }
+
+    // manipulators
+    void add_balls(color_type col, value_type n = 1) {
+        assert(col < number_of_colors());
+        assert(balls_with_color_[col] + n >= 0);
+
+        balls_with_color_[col] += n;
+        number_of_balls_ += n;
+
+        if (n > 0) {
+            touched_.touch(col);
+            ++num_insertions_;
+        }
+
+        switch (representation_) {
+        case Representation::Guide:
+            // wait for the next bulk update before we spend another rebuild
+            if (guide_.valid() && !guide_.covers(col, balls_with_color_[col])) {
+                guide_.invalidate();
+                guide_buildable_ = false;
+            }
+            break;
+        case Representation::Tree:
+            tree_.add_balls(col, n);
+            break;
+        case Representation::Alias:
+            alias_.add_balls(col, n);
+            break;
+        default:
+            break;
+        }
+
+        ++num_updates_;
+        count_operation();
+    }
+
+    void remove_balls(color_type col, value_type n = 1) { add_balls(col, -n); }
+
+    // sample single ball
+    template <typename Generator>
+    color_type get_random_ball(Generator &&gen) const {
+        assert(!empty());
+        ++num_draws_;
+
+        switch (representation_) {
+        case Representation::Guide:
+            if (guide_.valid())
+                return guide_.sample(gen, data());
+            return get_random_ball_linear(gen);
+        case Representation::Tree:
+            return tree_.get_random_ball(gen);
+        case Representation::Alias:
+            return alias_.get_random_ball(gen);
+        default:
+            return get_random_ball_linear(gen);
+        }
+    }
+
+    template <typename Generator>
+    color_type remove_random_ball(Generator &&gen) {
+        assert(!empty());
+        ++num_draws_;
+
+        color_type col;
+        switch (representation_) {
+        case Representation::Guide:
+            // rebuild once half of the balls covered by the table are gone
+            if (TLX_UNLIKELY(guide_buildable_ && (!guide_.valid() ||
+                                                  2 * number_of_balls_ < guide_.number_of_balls())))
+                guide_.build(data(), number_of_colors(), number_of_balls_);
+            col = guide_.valid() ? guide_.sample(gen, data()) : get_random_ball_linear(gen);
+            break;
+        case Representation::Tree:
+            col = tree_.remove_random_ball(gen);
+            break;
+        case Representation::Alias:
+            col = alias_.remove_random_ball(gen);
+            break;
+        default:
+            col = get_random_ball_linear(gen);
+            break;
+        }
+
+        --balls_with_color_[col];
+        --number_of_balls_;
+
+        count_operation();
+        return col;
+    }
+
+    // bulk operations
+    template <typename Urn>
+    void add_urn(const Urn &other) {
+        assert(other.number_of_colors() == number_of_colors());
+        for (color_type c = 0; c < number_of_colors(); ++c) {
+            if (const auto n = other.number_of_balls_with_color(c))
+                add_balls_in_bulk(c, n);
+        }
+        commit_bulk_update();
+    }
+
+    //! Takes time proportional to the number of colors touched in other since its last clear()
+    //! (plus the rebuild of a guide or alias table)
+    void add_urn(const AdaptiveUrn &other) {
+        assert(other.number_of_colors() == number_of_colors());
+        if (other.touched_.all()) {
+            add_urn<AdaptiveUrn>(other);
+            return;
+        }
+
+        for (auto col : other.touched_.listed()) {
+            if (const auto n = other.number_of_balls_with_color(col))
+                add_balls_in_bulk(col, n);
+        }
+        commit_bulk_update();
+    }
+
+    void clear() {
+        if (representation_ == Representation::Tree)
+            tree_.clear();
+
+        if (touched_.all()) {
+            std::fill(balls_with_color_.begin(), balls_with_color_.end(), 0);
+        } else {
+            for (auto col : touched_.listed())
+                balls_with_color_[col] = 0;
+        }
+
+        number_of_balls_ = 0;
+        touched_.reset();
+
+        if (representation_ == Representation::Alias)
+            alias_ = AliasUrnSimple(number_of_colors());
+
+        commit_bulk_update();
+    }
+
+    //! Samples num_of_samples balls without replacement and calls cb(color, num) for each
+    //! color (if CallOnEmpty also for colors not sampled) in increasing order
+    template <bool CallOnEmpty, typename Gen, typename Callback>
+    void sample_without_replacement(const value_type num_of_samples, Gen &gen,
+                                    Callback &&cb) const {
+        if (representation_ == Representation::Tree) {
+            tree_.sample_without_replacement<CallOnEmpty>(num_of_samples, gen, cb);
+        } else {
+            sample_linear<CallOnEmpty>(num_of_samples, gen, cb);
+        }
+    }
+
+    /// Same as sample_without_replacement, but actually removes balls from urn
+    template <bool CallOnEmpty, typename Gen, typename Callback>
+    void remove_random_balls(const value_type num_of_samples, Gen &gen, Callback &&cb) {
+        if (TLX_UNLIKELY(!number_of_balls() || !num_of_samples))
+            return;
+
+        assert(num_of_samples <= number_of_balls());
+
+        if (representation_ == Representation::Tree) {
+            tree_.remove_random_balls<CallOnEmpty>(num_of_samples, gen,
+                                                   [&](color_type col, value_type num) {
+                                                       balls_with_color_[col] -= num;
+                                                       cb(col, num);
+                                                   });
+        } else {
+            sample_linear<CallOnEmpty>(num_of_samples, gen, [&](color_type col, value_type num) {
+                balls_with_color_[col] -= num;
+                if (representation_ == Representation::Alias)
+                    alias_.bulk_add_balls(col, -num);
+                cb(col, num);
+            });
+
+            // the guide table remains valid as balls were only removed
+            if (representation_ == Representation::Alias)
+                alias_.bulk_commit();
+        }
+
+        number_of_balls_ -= num_of_samples;
+        ++num_bulk_updates_;
+        count_operation();
+    }
+
+private:
+    Representation representation_{Representation::Linear};
+
+    value_type number_of_balls_{0};
+    std::vector<value_type> balls_with_color_;
+    TouchedColors touched_; //!< superset of the colors with balls
+
+    GuideTable<value_type> guide_;
+    //! false if an insertion invalidated the table since the last bulk update
+    bool guide_buildable_{true};
+
+    TreeUrn tree_;         //!< mirrors the counts in Representation::Tree and is empty otherwise
+    AliasUrnSimple alias_; //!< mirrors the counts in Representation::Alias
+
+    // statistics of the current window
+    size_t window_;
+    size_t num_operations_{0};
+    mutable size_t num_draws_{0};
+    size_t num_updates_{0};
+    size_t num_insertions_{0};
+    size_t num_bulk_updates_{0};
+    size_t alias_rebuilds_at_window_start_{0};
+    double alias_rebuilds_per_operation_{0.0}; //!< last observed; decays while not in use
+
+    template <typename Generator>
+    color_type get_random_ball_linear(Generator &&gen) const {
+        auto value = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
+
+        size_t i = 0;
+        while (true) {
+            if (TLX_UNLIKELY(balls_with_color_[i] > value))
+                return i;
+            value -= balls_with_color_[i];
+            ++i;
+            assert(i < balls_with_color_.size());
+        }
+    }
+
+    template <bool CallOnEmpty, typename Gen, typename Callback>
+    void sample_linear(const value_type num_of_samples, Gen &gen, Callback &&cb) const {
+        if (TLX_UNLIKELY(!number_of_balls() || !num_of_samples))
+            return;
+
+        sampling::multivariate_hypergeometric<Gen, value_type> mvh(gen);
+        auto split = mvh.start(number_of_balls(), num_of_samples);
+
+        color_type col = 0;
+        for (; split.left_to_sample(); ++col) {
+            assert(col < number_of_colors());
+            const auto num_selected = split(balls_with_color_[col]);
+
+            if (CallOnEmpty || num_selected)
+                cb(col, num_selected);
+        }
+
+        if (CallOnEmpty) {
+            for (; col < number_of_colors(); ++col)
+                cb(col, 0);
+        }
+    }
+
+    void add_balls_in_bulk(color_type col, value_type n) {
+        balls_with_color_[col] += n;
+        number_of_balls_ += n;
+        touched_.touch(col);
+
+        if (representation_ == Representation::Tree) {
+            tree_.add_balls(col, n);
+        } else if (representation_ == Representation::Alias) {
+            alias_.bulk_add_balls(col, n);
+        }
+    }
+
+    void commit_bulk_update() {
+        if (representation_ == Representation::Guide) {
+            guide_.invalidate();
+            guide_buildable_ = true;
+        } else if (representation_ == Representation::Alias) {
+            alias_.bulk_commit();
+        }
+
+        ++num_bulk_updates_;
+        count_operation();
+    }
+
+    void count_operation() {
+        if (TLX_UNLIKELY(++num_operations_ >= window_))
+            adapt();
+    }
+
+    // estimated costs of the last window in each representation; the constants roughly
+    // correspond to nanoseconds per operation measured with main_benchmark
+    std::array<double, 4> estimate_costs() const {
+        const auto num_colors = static_cast<double>(number_of_colors());
+        const auto draws = static_cast<double>(num_draws_);
+        const auto updates = static_cast<double>(num_updates_);
+        const auto bulk = static_cast<double>(num_bulk_updates_);
+
+        // expected number of colors a linear scan visits
+        double expected_scan = 0.0;
+        if (number_of_balls_) {
+            for (color_type c = 0; c < number_of_colors(); ++c)
+                expected_scan += static_cast<double>(c + 1) * balls_with_color_[c];
+            expected_scan /= number_of_balls_;
+        }
+
+        std::array<double, 4> costs;
+        costs[static_cast<size_t>(Representation::Linear)] =
+            draws * (15.0 + 0.45 * expected_scan) + updates * 2.0 + bulk * num_colors;
+
+        // an insertion may exceed the table and forces draws into the linear scan
+        costs[static_cast<size_t>(Representation::Guide)] =
+            (16 * num_insertions_ > num_draws_)
+                ? std::numeric_limits<double>::infinity()
+                : draws * 15.0 + updates * 2.0 + bulk * 3.0 * num_colors;
+
+        costs[static_cast<size_t>(Representation::Tree)] =
+            (draws + updates) * 4.0 * std::log2(num_colors) + bulk * num_colors;
+
+        costs[static_cast<size_t>(Representation::Alias)] =
+            draws * 10.0 + updates * 8.0 +
+            (bulk + alias_rebuilds_per_operation_ * num_operations_) * 4.0 * num_colors;
+
+        return costs;
+    }
+
+    void adapt() {
+        if (representation_ == Representation::Alias) {
+            alias_rebuilds_per_operation_ =
+                static_cast<double>(alias_.number_of_rebuilds() - alias_rebuilds_at_window_start_) /
+                num_operations_;
+        } else {
+            // forget a bad experience eventually
+            alias_rebuilds_per_operation_ /= 2;
+        }
+
+        if (number_of_colors() >= kMinColorsToAdapt) {
+            const auto costs = estimate_costs();
+            const auto best = static_cast<Representation>(
+                std::min_element(costs.cbegin(), costs.cend()) - costs.cbegin());
+
+            // hysteresis: only migrate if it pays off clearly
+            const auto current_cost = costs[static_cast<size_t>(representation_)];
+            if (costs[static_cast<size_t>(best)] < 0.75 * current_cost)
+                migrate(best);
+        }
+
+        num_operations_ = 0;
+        num_draws_ = 0;
+        num_updates_ = 0;
+        num_insertions_ = 0;
+        num_bulk_updates_ = 0;
+        alias_rebuilds_at_window_start_ = alias_.number_of_rebuilds();
+    }
+
+    void migrate(Representation target) {
+        if (representation_ == Representation::Tree)
+            tree_.clear();
+
+        representation_ = target;
+
+        switch (target) {
+        case Representation::Guide:
+            guide_buildable_ = true;
+            guide_.build(data(), number_of_colors(), number_of_balls_);
+            break;
+        case Representation::Tree:
+            tree_.add_urn(*this);
+            break;
+        case Representation::Alias:
+            alias_ = AliasUrnSimple(number_of_colors());
+            for (color_type c = 0; c < number_of_colors(); ++c)
+                alias_.bulk_add_balls(c, balls_with_color_[c]);
+            alias_.bulk_commit();
+            break;
+        default:
+            break;
+        }
+
+        if (target != Representation::Guide)
+            guide_.release();
+    }
+};
+
+} // namespace urns
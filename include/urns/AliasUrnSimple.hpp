@@ -27,6 +27,7 @@
 #include <vector>
 #include <tlx/math.hpp>
 
+#include <urns/BoundedUniform.hpp>
 #include <urns/Traits.hpp>
 
 namespace urns {
@@ -95,6 +96,44 @@ public:
         return std::get<1>(get_random_ball_(gen));
     }
 
+    /**
+     * Draws two distinct balls of colors (a, b) and replaces them by balls of the colors
+     * (c, d) = transition(a, b). A ball that keeps its color stays in its cell of the table,
+     * so unchanged agents cause no updates (and no row fixes or rebuilds) at all.
+     */
+    template <typename Generator, typename Transition>
+    void replace_random_pair(Generator &gen, Transition &&transition) {
+        assert(number_of_balls() > 1);
+
+        // hide the first ball while drawing the second one; the table stays within
+        // row_current_max_, so get_random_ball_ remains valid
+        const auto first = get_random_ball_(gen);
+        auto &first_weight = cell_weight(first);
+        --first_weight;
+        const auto second = get_random_ball_(gen);
+        ++first_weight;
+
+        const auto [new_first, new_second] = transition(std::get<1>(first), std::get<1>(second));
+        const bool first_changes = (new_first != std::get<1>(first));
+        const bool second_changes = (new_second != std::get<1>(second));
+
+        // remove both balls before checking any row, as a rebuild invalidates the cells
+        if (first_changes)
+            remove_from_cell(first);
+        if (second_changes)
+            remove_from_cell(second);
+
+        if (first_changes && !fix_row_after_removal(gen, std::get<0>(first)))
+            build_alias_table();
+        else if (second_changes && !fix_row_after_removal(gen, std::get<0>(second)))
+            build_alias_table();
+
+        if (first_changes)
+            add_balls(new_first);
+        if (second_changes)
+            add_balls(new_second);
+    }
+
     value_type number_of_balls() const noexcept { return number_of_balls_; }
 
     value_type number_of_balls_with_color(color_type col) const noexcept {
@@ -105,6 +144,9 @@ public:
 
     bool empty() const noexcept { return !number_of_balls(); }
 
+    //! Number of times the alias table was built from scratch
+    size_t number_of_rebuilds() const noexcept { return number_of_rebuilds_; }
+
     template <typename Urn>
     void add_urn(const Urn &other) {
         assert(other.number_of_colors() == number_of_colors());
@@ -140,10 +182,12 @@ private:
     value_type row_weight_upper_{0};
     value_type row_current_max_{0};
 
+    size_t number_of_rebuilds_{0};
+
     template <typename Gen>
     auto get_random_ball_(Gen &&gen) const {
         assert(!empty());
-        std::uniform_int_distribution<size_t> distr{0, number_of_colors() * row_current_max_ - 1};
+        UniformInt<size_t> distr{0, number_of_colors() * row_current_max_ - 1};
 
         while (true) {
             const auto random = distr(gen);
@@ -162,6 +206,25 @@ private:
         }
     }
 
+    template <typename Cell>
+    value_type &cell_weight(const Cell &cell) noexcept {
+        return alias_table_[std::get<0>(cell)].weights[static_cast<size_t>(std::get<2>(cell))];
+    }
+
+    template <typename Cell>
+    void remove_from_cell(const Cell &cell) noexcept {
+        cell_weight(cell)--;
+        balls_with_color_[std::get<1>(cell)]--;
+        number_of_balls_--;
+    }
+
+    //! Returns false if the row dropped below the lower threshold and could not be fixed
+    template <typename Gen>
+    bool fix_row_after_removal(Gen &gen, size_t row_id) {
+        return TLX_LIKELY(alias_table_[row_id].total_weight() >= row_weight_lower_)
+               || try_fix_row(gen, row_id);
+    }
+
     void categorize_into_small_and_large() {
         const auto average_floored = number_of_balls() / number_of_colors();
 
@@ -256,7 +319,7 @@ private:
     template <typename Gen>
     bool try_fix_row(Gen &gen, size_t row_id) {
         auto &row = alias_table_[row_id];
-        std::uniform_int_distribution<color_type> color_distr(0, number_of_colors() - 1);
+        UniformInt<color_type> color_distr(0, number_of_colors() - 1);
 
         for (unsigned i = 0; i < 5; ++i) {
             auto partner_id = color_distr(gen);
@@ -285,6 +348,7 @@ private:
             return;
 
         assert_consistency(true);
+        ++number_of_rebuilds_;
 
         categorize_into_small_and_large();
         split_large_elements();
@@ -318,5 +382,10 @@ struct has_bulk_insertions<AliasUrnSimple> {
     static constexpr bool value = true;
 };
 
+template <>
+struct has_pair_replacement<AliasUrnSimple> {
+    static constexpr bool value = true;
+};
+
 } // namespace traits
 } // namespace urns
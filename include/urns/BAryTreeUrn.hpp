@@ -0,0 +1,352 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include <sampling/multivariate_hypergeometric.hpp>
+#include <tlx/define/likely.hpp>
+#include <urns/BoundedUniform.hpp>
+#include <urns/TouchedColors.hpp>
+
+namespace urns {
+
+/**
+ * Same interface as TreeUrn, but uses a B-ary tree whose nodes fill exactly one cache line.
+ * Each node stores the inclusive prefix sums of the weights of its B = 64 / sizeof(Count)
+ * children, so a descent selects the child with a single (SIMD) comparison of the node
+ * against the random value. Compared to the binary TreeUrn the tree is log2(B) times
+ * shallower, i.e. a random ball costs 4 (Count = uint32_t) or 3 (Count = uint64_t)
+ * times fewer dependent cache misses.
+ *
+ * The levels are stored top-down and each level only holds as many nodes as required for
+ * number_of_colors() leaves. Counts are kept as unsigned integers with wrap-around
+ * arithmetic; hence BAryTreeUrn<uint32_t> must never hold 2^32 or more balls.
+ */
+template <typename Count = uint64_t>
+class BAryTreeUrn {
+    static_assert(std::is_unsigned_v<Count> && (sizeof(Count) == 4 || sizeof(Count) == 8),
+                  "Count has to be a 32 or 64 bit unsigned integer");
+
+public:
+    using value_type = int64_t;
+    using color_type = size_t;
+    using count_type = Count;
+
+    static constexpr size_t kArity = 64 / sizeof(Count);
+
+    explicit BAryTreeUrn(color_type number_of_colors)
+        : number_of_colors_(number_of_colors), balls_with_color_(number_of_colors, 0),
+          touched_(number_of_colors) {
+        // number of nodes per level, starting with the parents of the leaves
+        std::vector<size_t> level_sizes;
+        size_t width = number_of_colors;
+        do {
+            width = (width + kArity - 1) / kArity;
+            level_sizes.push_back(width);
+        } while (width > 1);
+
+        size_t num_nodes = 0;
+        for (auto it = level_sizes.crbegin(); it != level_sizes.crend(); ++it) {
+            level_begin_.push_back(num_nodes);
+            num_nodes += *it;
+        }
+
+        nodes_.resize(num_nodes);
+        for (auto &node : nodes_)
+            node.sums.fill(0);
+    }
+
+    void add_balls(color_type col, value_type n = 1) {
+        assert(col < number_of_colors_);
+        number_of_balls_ += n;
+        balls_with_color_[col] += static_cast<Count>(n);
+        touched_.touch(col);
+
+        for (size_t level = depth(); level--;) {
+            add_to_suffix(nodes_[level_begin_[level] + col / kArity].sums, col % kArity,
+                          static_cast<Count>(n));
+            col /= kArity;
+        }
+    }
+
+    void set_balls(color_type col, value_type n) {
+        add_balls(col, n - number_of_balls_with_color(col));
+    }
+
+    void remove_balls(color_type col, value_type n) { add_balls(col, -n); }
+
+    template <typename Generator>
+    std::pair<color_type, value_type> remove_random_ball_with_index(Generator &&gen) noexcept {
+        assert(!empty());
+        auto value = static_cast<Count>(
+            UniformInt<value_type>{0, number_of_balls_ - 1}(gen));
+
+        size_t i = 0;
+        for (size_t level = 0; level < depth(); ++level) {
+            auto &sums = nodes_[level_begin_[level] + i].sums;
+            const auto child = select_child(sums, value);
+            if (child)
+                value -= sums[child - 1];
+
+            add_to_suffix(sums, child, static_cast<Count>(-1));
+
+            i = i * kArity + child;
+        }
+
+        assert(i < number_of_colors_);
+        --number_of_balls_;
+        balls_with_color_[i]--;
+
+        return {i, static_cast<value_type>(value)};
+    }
+
+    template <typename Generator>
+    color_type remove_random_ball(Generator &&gen) noexcept {
+        return remove_random_ball_with_index(std::forward<Generator>(gen)).first;
+    }
+
+    template <typename Generator>
+    std::pair<color_type, value_type> get_random_ball_with_index(Generator &&gen) const noexcept {
+        assert(!empty());
+        auto value = static_cast<Count>(
+            UniformInt<value_type>{0, number_of_balls_ - 1}(gen));
+
+        size_t i = 0;
+        for (size_t level = 0; level < depth(); ++level) {
+            const auto &sums = nodes_[level_begin_[level] + i].sums;
+            const auto child = select_child(sums, value);
+            if (child)
+                value -= sums[child - 1];
+
+            i = i * kArity + child;
+        }
+
+        assert(i < number_of_colors_);
+        return {i, static_cast<value_type>(value)};
+    }
+
+    template <typename Generator>
+    color_type get_random_ball(Generator &&gen) const noexcept {
+        return get_random_ball_with_index(std::forward<Generator>(gen)).first;
+    }
+
+    value_type number_of_balls_with_color(color_type col) const noexcept {
+        return static_cast<value_type>(balls_with_color_[col]);
+    }
+
+    value_type number_of_balls() const noexcept { return number_of_balls_; }
+
+    //! Contiguous array of number_of_colors() counts,
+    //! i.e. data()[i] == number_of_balls_with_color(i)
+    const count_type *data() const noexcept { return balls_with_color_.data(); }
+
+    color_type number_of_colors() const noexcept { return number_of_colors_; }
+
+    bool empty() const noexcept { return !number_of_balls(); }
+
+    template <typename Urn>
+    void add_urn(const Urn &other) {
+        assert(other.number_of_colors() == number_of_colors());
+        for (color_type c = 0; c < number_of_colors(); ++c) {
+            const auto n = other.number_of_balls_with_color(c);
+            balls_with_color_[c] += static_cast<Count>(n);
+            if (n)
+                touched_.touch(c);
+        }
+
+        number_of_balls_ += other.number_of_balls();
+        build_tree_from_balls();
+    }
+
+    //! Only visits the colors touched in other since its last clear(), if there are few
+    void add_urn(const BAryTreeUrn &other) {
+        assert(other.number_of_colors() == number_of_colors());
+
+        if (!other.touched_.all()) {
+            for (auto col : other.touched_.listed()) {
+                if (const auto n = other.number_of_balls_with_color(col))
+                    add_balls(col, n);
+            }
+            return;
+        }
+
+        // prefix sums are linear, so we can add the trees node by node
+        for (size_t i = 0; i < nodes_.size(); ++i) {
+            for (size_t j = 0; j < kArity; ++j)
+                nodes_[i].sums[j] += other.nodes_[i].sums[j];
+        }
+
+        for (color_type c = 0; c < number_of_colors(); ++c)
+            balls_with_color_[c] += other.balls_with_color_[c];
+
+        number_of_balls_ += other.number_of_balls();
+        touched_.touch_all();
+    }
+
+    //! Only visits the colors touched since the last clear() and their ancestors, if there are few
+    void clear() {
+        number_of_balls_ = 0;
+
+        if (touched_.all()) {
+            std::fill(balls_with_color_.begin(), balls_with_color_.end(), 0);
+            for (auto &node : nodes_)
+                node.sums.fill(0);
+        } else {
+            for (auto col : touched_.listed()) {
+                balls_with_color_[col] = 0;
+                for (size_t level = depth(); level--;) {
+                    col /= kArity;
+                    nodes_[level_begin_[level] + col].sums.fill(0);
+                }
+            }
+        }
+
+        touched_.reset();
+    }
+
+    // sample frequencies
+    template <bool CallOnEmpty, typename Gen, typename Callback>
+    void sample_without_replacement(const value_type num_of_samples, Gen &gen,
+                                    Callback &&cb) const {
+        if (TLX_UNLIKELY(!number_of_balls() || !num_of_samples))
+            return;
+
+        sampling::multivariate_hypergeometric<Gen, value_type> mvh(gen);
+        auto split = mvh.start(number_of_balls(), num_of_samples);
+
+        color_type col = 0;
+        while (split.left_to_sample()) {
+            assert(col < number_of_colors());
+            const auto num_selected = split(number_of_balls_with_color(col));
+
+            if (CallOnEmpty || num_selected)
+                cb(col, num_selected);
+
+            col++;
+        }
+
+        if (CallOnEmpty) {
+            for (; col < number_of_colors(); ++col)
+                cb(col, 0);
+        }
+    }
+
+    /// Same as sample_without_replacement, but actually removes balls from urn
+    template <bool CallOnEmpty, typename Gen, typename Callback>
+    void remove_random_balls(const value_type num_of_samples, Gen &gen, Callback &&cb) {
+        sample_without_replacement<CallOnEmpty>(num_of_samples, gen,
+                                                [&](color_type color, value_type num) {
+                                                    remove_balls(color, num);
+                                                    cb(color, num);
+                                                });
+    }
+
+private:
+    struct alignas(64) Node {
+        std::array<Count, kArity> sums; //!< sums[j] = weight of the children 0 to j
+    };
+
+    value_type number_of_balls_{0};
+    size_t number_of_colors_{0};
+
+    std::vector<Node> nodes_;
+    std::vector<size_t> level_begin_; //!< index of the first node of each level, root first
+    std::vector<Count> balls_with_color_;
+
+    TouchedColors touched_; //!< superset of the colors with balls
+
+    size_t depth() const noexcept { return level_begin_.size(); }
+
+    /// Number of children whose prefix sum does not exceed value, i.e. the child to descend to
+    static size_t select_child(const std::array<Count, kArity> &sums, Count value) noexcept {
+#if defined(__AVX512F__)
+        const __m512i node = _mm512_load_si512(sums.data());
+        if constexpr (sizeof(Count) == 4) {
+            return static_cast<size_t>(__builtin_popcount(
+                _mm512_cmple_epu32_mask(node, _mm512_set1_epi32(static_cast<int>(value)))));
+        } else {
+            return static_cast<size_t>(__builtin_popcount(_mm512_cmple_epu64_mask(
+                node, _mm512_set1_epi64(static_cast<long long>(value)))));
+        }
+#else
+        size_t child = 0;
+        for (size_t j = 0; j < kArity; ++j)
+            child += (sums[j] <= value);
+        return child;
+#endif
+    }
+
+    /// Adds delta to the prefix sums of all children from first_child on
+    static void add_to_suffix(std::array<Count, kArity> &sums, size_t first_child,
+                              Count delta) noexcept {
+#if defined(__AVX512F__)
+        const __m512i node = _mm512_load_si512(sums.data());
+        if constexpr (sizeof(Count) == 4) {
+            const auto mask = static_cast<__mmask16>(0xffffu << first_child);
+            _mm512_store_si512(sums.data(),
+                               _mm512_mask_add_epi32(node, mask, node,
+                                                     _mm512_set1_epi32(static_cast<int>(delta))));
+        } else {
+            const auto mask = static_cast<__mmask8>(0xffu << first_child);
+            const auto deltas = _mm512_set1_epi64(static_cast<long long>(delta));
+            _mm512_store_si512(sums.data(), _mm512_mask_add_epi64(node, mask, node, deltas));
+        }
+#else
+        for (size_t j = 0; j < kArity; ++j)
+            sums[j] += (j >= first_child) ? delta : 0;
+#endif
+    }
+
+    void build_tree_from_balls() {
+        // weight of the subtree rooted in child j of the current level
+        std::vector<Count> weights(balls_with_color_);
+
+        for (size_t level = depth(); level--;) {
+            const auto begin = level_begin_[level];
+            const auto end = level + 1 < depth() ? level_begin_[level + 1] : nodes_.size();
+
+            for (size_t i = begin; i < end; ++i) {
+                Count sum = 0;
+                for (size_t j = 0; j < kArity; ++j) {
+                    const auto child = (i - begin) * kArity + j;
+                    sum += child < weights.size() ? weights[child] : 0;
+                    nodes_[i].sums[j] = sum;
+                }
+            }
+
+            weights.resize(end - begin);
+            for (size_t i = begin; i < end; ++i)
+                weights[i - begin] = nodes_[i].sums[kArity - 1];
+        }
+    }
+};
+
+} // namespace urns
@@ -0,0 +1,121 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <type_traits>
+
+#include <tlx/define/likely.hpp>
+
+namespace urns {
+
+/**
+ * Uniform integer from [a, b] with Lemire's nearly divisionless method ("Fast Random Integer
+ * Generation in an Interval", 2019): the product of a random word and the size of the range
+ * is split into its high word, which is the result, and its low word, which decides whether
+ * the word falls into the (tiny) biased part of the range. Only then we need a division to
+ * compute the rejection threshold. In contrast, std::uniform_int_distribution of libstdc++
+ * divides at least once per draw.
+ *
+ * The fast path requires a generator with 32 or 64 uniform bits (e.g., std::mt19937_64) and
+ * ranges that fit into its words; otherwise we fall back to std::uniform_int_distribution.
+ */
+template <typename T = uint64_t>
+class BoundedUniform {
+    static_assert(std::is_integral_v<T>);
+    using unsigned_type = std::make_unsigned_t<T>;
+
+public:
+    using result_type = T;
+
+    BoundedUniform() : BoundedUniform(0, std::numeric_limits<T>::max()) {}
+
+    BoundedUniform(T a, T b) : a_(a), b_(b) { assert(a <= b); }
+
+    T a() const noexcept { return a_; }
+
+    T b() const noexcept { return b_; }
+
+    template <typename Gen>
+    T operator()(Gen &gen) {
+        constexpr auto kGenRange = Gen::max() - Gen::min();
+
+        const auto range = static_cast<unsigned_type>(static_cast<unsigned_type>(b_)
+                                                      - static_cast<unsigned_type>(a_));
+
+        if constexpr (Gen::min() == 0 && kGenRange == std::numeric_limits<uint64_t>::max()) {
+            return offset(draw<uint64_t, __uint128_t>(gen, range));
+
+        } else if constexpr (Gen::min() == 0 && kGenRange == std::numeric_limits<uint32_t>::max()) {
+            if (TLX_LIKELY(range <= std::numeric_limits<uint32_t>::max()))
+                return offset(draw<uint32_t, uint64_t>(gen, static_cast<uint32_t>(range)));
+        }
+
+        return std::uniform_int_distribution<T>{a_, b_}(gen);
+    }
+
+private:
+    T a_;
+    T b_;
+
+    T offset(unsigned_type x) const noexcept {
+        return static_cast<T>(static_cast<unsigned_type>(a_) + x);
+    }
+
+    /// Uniform in [0, range] for a generator with full Word range
+    template <typename Word, typename DoubleWord, typename Gen>
+    static Word draw(Gen &gen, Word range) {
+        if (TLX_UNLIKELY(range == std::numeric_limits<Word>::max()))
+            return static_cast<Word>(gen());
+
+        const Word size = range + 1;
+        auto product = static_cast<DoubleWord>(static_cast<Word>(gen())) * size;
+        auto low = static_cast<Word>(product);
+
+        if (TLX_UNLIKELY(low < size)) {
+            // 2^w mod size; words with low below it would make some results more likely
+            const Word threshold = static_cast<Word>(-size) % size;
+            while (low < threshold) {
+                product = static_cast<DoubleWord>(static_cast<Word>(gen())) * size;
+                low = static_cast<Word>(product);
+            }
+        }
+
+        return static_cast<Word>(product >> (8 * sizeof(Word)));
+    }
+};
+
+/**
+ * Bounded integer distribution used on the hot paths of urns and simulators. Define
+ * PPS_STD_UNIFORM_INT (CMake option of the same name) to use std::uniform_int_distribution
+ * instead, e.g., to compare results or performance.
+ */
+#ifdef PPS_STD_UNIFORM_INT
+template <typename T>
+using UniformInt = std::uniform_int_distribution<T>;
+#else
+template <typename T>
+using UniformInt = BoundedUniform<T>;
+#endif
+
+} // namespace urns
@@ -0,0 +1,182 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <tlx/math.hpp>
+
+#include <urns/BoundedUniform.hpp>
+
+namespace urns {
+
+/**
+ * Dynamic urn in the spirit of Matias, Vitter, and Ni: a color with n > 0 balls belongs to
+ * the group floor(log2(n)), i.e. all colors of group g have between 2^g and 2^(g+1) - 1
+ * balls. To draw a ball, we select a group proportional to its total weight (there are at
+ * most 64 groups), and then a color within the group by rejection sampling against the
+ * upper bound 2^(g+1). Each trial succeeds with probability at least 1/2.
+ *
+ * Sampling hence takes O(1) expected time and adding / removing balls O(1) time (a color
+ * moves between groups by swapping it with the last member); in contrast to AliasUrnSimple
+ * there are no global rebuilds, regardless of how the distribution drifts.
+ */
+class BucketUrn {
+public:
+    using value_type = int64_t;
+    using color_type = size_t;
+
+    static constexpr unsigned kNumGroups = 64;
+
+    explicit BucketUrn(color_type number_of_colors)
+        : balls_with_color_(number_of_colors, 0), position_in_group_(number_of_colors, 0) {
+        assert(number_of_colors > 0);
+        group_weights_.fill(0);
+    }
+
+    void add_balls(color_type col, value_type n = 1) {
+        assert(col < number_of_colors());
+        assert(balls_with_color_[col] + n >= 0);
+
+        const auto old_num = balls_with_color_[col];
+        const auto new_num = old_num + n;
+
+        balls_with_color_[col] = new_num;
+        number_of_balls_ += n;
+
+        if (old_num) {
+            const auto group = group_of(old_num);
+            group_weights_[group] -= old_num;
+            if (!new_num || group != group_of(new_num))
+                remove_from_group(col, group);
+        }
+
+        if (new_num) {
+            const auto group = group_of(new_num);
+            group_weights_[group] += new_num;
+            if (!old_num || group != group_of(old_num))
+                insert_into_group(col, group);
+        }
+    }
+
+    void set_balls(color_type col, value_type n) {
+        add_balls(col, n - number_of_balls_with_color(col));
+    }
+
+    void remove_balls(color_type col, value_type n) { add_balls(col, -n); }
+
+    template <typename Generator>
+    color_type remove_random_ball(Generator &&gen) {
+        const auto col = get_random_ball(gen);
+        add_balls(col, -1);
+        return col;
+    }
+
+    template <typename Generator>
+    color_type get_random_ball(Generator &&gen) const noexcept {
+        assert(!empty());
+
+        // select group proportional to its weight; heavy groups tend to have high indices
+        auto candidates = non_empty_groups_;
+        auto group = tlx::integer_log2_floor(candidates);
+        if (candidates & (candidates - 1)) {
+            auto value = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
+            while (value >= group_weights_[group]) {
+                value -= group_weights_[group];
+                candidates &= ~(uint64_t{1} << group);
+                assert(candidates);
+                group = tlx::integer_log2_floor(candidates);
+            }
+        }
+
+        // rejection sampling within the group; as each member has at least 2^group balls,
+        // the range members.size() << (group + 1) does not exceed 2 * number_of_balls()
+        const auto &members = groups_[group];
+        const auto shift = group + 1;
+        UniformInt<uint64_t> distr{0, (members.size() << shift) - 1};
+        while (true) {
+            const auto variate = distr(gen);
+            const auto col = members[variate >> shift];
+            const auto weight = static_cast<value_type>(variate & ((uint64_t{1} << shift) - 1));
+
+            if (weight < balls_with_color_[col])
+                return col;
+        }
+    }
+
+    value_type number_of_balls() const noexcept { return number_of_balls_; }
+
+    value_type number_of_balls_with_color(color_type col) const noexcept {
+        return balls_with_color_[col];
+    }
+
+    color_type number_of_colors() const noexcept { return balls_with_color_.size(); }
+
+    bool empty() const noexcept { return !number_of_balls(); }
+
+    template <typename Urn>
+    void add_urn(const Urn &other) {
+        assert(other.number_of_colors() == number_of_colors());
+        for (color_type c = 0; c < number_of_colors(); ++c) {
+            if (const auto n = other.number_of_balls_with_color(c))
+                add_balls(c, n);
+        }
+    }
+
+private:
+    value_type number_of_balls_{0};
+
+    std::vector<value_type> balls_with_color_;
+    std::vector<size_t> position_in_group_; //!< index of a color within groups_[its group]
+
+    std::array<std::vector<color_type>, kNumGroups> groups_;
+    std::array<value_type, kNumGroups> group_weights_;
+    uint64_t non_empty_groups_{0}; //!< bit g is set iff groups_[g] is not empty
+
+    static unsigned group_of(value_type num) noexcept {
+        assert(num > 0);
+        return tlx::integer_log2_floor(static_cast<uint64_t>(num));
+    }
+
+    void insert_into_group(color_type col, unsigned group) {
+        position_in_group_[col] = groups_[group].size();
+        groups_[group].push_back(col);
+        non_empty_groups_ |= uint64_t{1} << group;
+    }
+
+    void remove_from_group(color_type col, unsigned group) noexcept {
+        auto &members = groups_[group];
+        const auto pos = position_in_group_[col];
+        assert(members[pos] == col);
+
+        members[pos] = members.back();
+        position_in_group_[members[pos]] = pos;
+        members.pop_back();
+
+        if (members.empty())
+            non_empty_groups_ &= ~(uint64_t{1} << group);
+    }
+};
+
+} // namespace urns
@@ -0,0 +1,127 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <tlx/define/likely.hpp>
+#include <urns/BoundedUniform.hpp>
+
+namespace urns {
+
+/**
+ * Guide table (Chen and Asau) over the counts of an urn. It stores the prefix sums of all
+ * counts and, for each of m equally sized buckets of the ball range, the first color
+ * intersecting the bucket. A draw jumps to the color of its bucket and scans O(1) colors in
+ * expectation. Building the table takes Theta(m) time.
+ *
+ * The table does not need to be patched as balls are removed from the urn: a draw from the
+ * frozen prefix sums is rejected if it hits a ball that was removed since. It remains
+ * valid as long as no color exceeds its count at build time (see covers()).
+ */
+template <typename Count>
+class GuideTable {
+public:
+    using count_type = Count;
+    using color_type = size_t;
+
+    bool valid() const noexcept { return valid_; }
+
+    void invalidate() noexcept { valid_ = false; }
+
+    void release() {
+        valid_ = false;
+        prefix_ = {};
+        guide_ = {};
+    }
+
+    //! Number of balls at build time
+    count_type number_of_balls() const noexcept {
+        assert(valid_);
+        return prefix_.back();
+    }
+
+    //! True if a color with n balls is still covered by the table
+    bool covers(color_type col, count_type n) const noexcept {
+        assert(valid_);
+        return n <= prefix_[col + 1] - prefix_[col];
+    }
+
+    void build(const count_type *counts, size_t num_colors, count_type num_balls) {
+        valid_ = num_balls > 0;
+        if (!valid_)
+            return;
+
+        prefix_.resize(num_colors + 1);
+        prefix_[0] = 0;
+        std::partial_sum(counts, counts + num_colors, prefix_.begin() + 1);
+        assert(prefix_.back() == num_balls);
+
+        guide_.resize(num_colors);
+        scale_ = static_cast<double>(num_colors) / num_balls;
+
+        // bucket b is assigned to the color of its smallest ball
+        size_t bucket = 0;
+        for (color_type c = 0; c < num_colors && bucket < num_colors; ++c) {
+            if (!counts[c])
+                continue;
+            const auto last_bucket = bucket_of(prefix_[c + 1] - 1);
+            for (; bucket <= last_bucket; ++bucket)
+                guide_[bucket] = c;
+        }
+    }
+
+    //! Draws a ball uniformly from the current counts, which must be covered by the table
+    template <typename Gen>
+    color_type sample(Gen &gen, const count_type *counts) const {
+        assert(valid_);
+        UniformInt<count_type> distr(0, prefix_.back() - 1);
+        while (true) {
+            const auto ball = distr(gen);
+
+            auto color = guide_[bucket_of(ball)];
+            assert(prefix_[color] <= ball);
+            while (prefix_[color + 1] <= ball)
+                ++color;
+
+            // accept if the ball has not been removed since the table was built
+            if (TLX_LIKELY(ball - prefix_[color] < counts[color]))
+                return color;
+        }
+    }
+
+private:
+    bool valid_{false};
+    std::vector<count_type> prefix_; //!< m+1 prefix sums of the counts at build time
+    std::vector<color_type> guide_;  //!< first color intersecting each bucket
+    double scale_{0.0};              //!< number of buckets per ball
+
+    size_t bucket_of(count_type ball) const noexcept {
+        // the floating point product is monotone in ball, which is all we rely on
+        return std::min<size_t>(static_cast<size_t>(ball * scale_), guide_.size() - 1);
+    }
+};
+
+} // namespace urns
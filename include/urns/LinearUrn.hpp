@@ -20,11 +20,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <random>
 #include <vector>
 #include <tlx/math.hpp>
 
+#include <urns/BoundedUniform.hpp>
+#include <urns/Traits.hpp>
+
 namespace urns {
 
 class LinearUrn {
@@ -44,7 +48,7 @@ public:
     template <typename Generator>
     color_type remove_random_ball(Generator &&gen) noexcept {
         assert(!empty());
-        auto value = std::uniform_int_distribution<value_type>{0, --number_of_balls_}(gen);
+        auto value = UniformInt<value_type>{0, --number_of_balls_}(gen);
 
         size_t i = 0;
         while (true) {
@@ -60,7 +64,7 @@ public:
     template <typename Generator>
     color_type get_random_ball(Generator &&gen) const noexcept {
         assert(!empty());
-        auto value = std::uniform_int_distribution<value_type>{0, number_of_balls_ - 1}(gen);
+        auto value = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
 
         size_t i = 0;
         while (true) {
@@ -72,6 +76,48 @@ public:
         }
     }
 
+    /**
+     * Draws two distinct balls of colors (a, b) and replaces them by balls of the colors
+     * (c, d) = transition(a, b). A single scan finds both balls, and only agents that change
+     * their color cause updates.
+     */
+    template <typename Generator, typename Transition>
+    void replace_random_pair(Generator &gen, Transition &&transition) {
+        assert(number_of_balls_ > 1);
+
+        // the second ball is drawn among all balls except the first one
+        const auto first = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
+        auto second = UniformInt<value_type>{0, number_of_balls_ - 2}(gen);
+        second += (second >= first);
+
+        // the order of both balls is random, so we sort them by indexing rather than branching
+        const bool swapped = (second < first);
+        const auto values = std::array<value_type, 2>{first, second};
+        auto lower = values[swapped];
+        auto upper = values[!swapped];
+
+        // scan until we find the upper ball; the lower one lies in the first color whose
+        // prefix sum exceeds it, so we count the colors before it without branching
+        color_type lower_color = 0;
+        color_type upper_color = 0;
+        while (balls_[upper_color] <= upper) {
+            upper -= balls_[upper_color];
+            lower -= balls_[upper_color];
+            lower_color += (lower >= 0);
+            ++upper_color;
+        }
+
+        const auto colors = std::array<color_type, 2>{lower_color, upper_color};
+        const auto old_first = colors[swapped];
+        const auto old_second = colors[!swapped];
+        const auto [new_first, new_second] = transition(old_first, old_second);
+
+        --balls_[old_first];
+        ++balls_[new_first];
+        --balls_[old_second];
+        ++balls_[new_second];
+    }
+
     value_type number_of_balls() const noexcept { return number_of_balls_; }
 
     value_type number_of_balls_with_color(color_type col) const noexcept { return balls_[col]; }
@@ -85,4 +131,12 @@ private:
     std::vector<value_type> balls_;
 };
 
+namespace traits {
+
+template <>
+struct has_pair_replacement<LinearUrn> {
+    static constexpr bool value = true;
+};
+
+} // namespace traits
 } // namespace urns
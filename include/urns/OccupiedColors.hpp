@@ -0,0 +1,165 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace urns {
+
+/**
+ * Bitmap of the colors with at least one ball. It is maintained incrementally by the urns
+ * and lets callers iterate over the occupied colors in increasing order in time
+ * O(number_of_colors / 64 + number of occupied colors), rather than visiting all colors.
+ *
+ * Iteration reads the bitmap lazily: colors up to the current one may be emptied (e.g. by
+ * removing balls) while iterating.
+ */
+class OccupiedColors {
+public:
+    explicit OccupiedColors(size_t num_colors)
+        : num_colors_(num_colors), words_((num_colors + 63) / 64, 0) {}
+
+    bool contains(size_t col) const noexcept {
+        assert(col < num_colors_);
+        return (words_[col / 64] >> (col % 64)) & 1;
+    }
+
+    //! Number of occupied colors
+    size_t size() const noexcept { return size_; }
+
+    bool empty() const noexcept { return !size_; }
+
+    void insert(size_t col) noexcept {
+        assert(!contains(col));
+        words_[col / 64] |= uint64_t{1} << (col % 64);
+        ++size_;
+    }
+
+    void erase(size_t col) noexcept {
+        assert(contains(col));
+        words_[col / 64] &= ~(uint64_t{1} << (col % 64));
+        --size_;
+    }
+
+    //! Call whenever the number of balls of col changes from old_num to new_num
+    template <typename T>
+    void update(size_t col, T old_num, T new_num) noexcept {
+        if (!old_num != !new_num) {
+            if (new_num) {
+                insert(col);
+            } else {
+                erase(col);
+            }
+        }
+    }
+
+    //! Rebuilds the bitmap from a count array
+    template <typename T>
+    void assign(const T *counts) noexcept {
+        size_ = 0;
+        for (size_t w = 0; w < words_.size(); ++w) {
+            const auto end = std::min(num_colors_, 64 * w + 64);
+            uint64_t word = 0;
+            for (size_t col = 64 * w; col < end; ++col)
+                word |= uint64_t{!!counts[col]} << (col % 64);
+            words_[w] = word;
+            size_ += __builtin_popcountll(word);
+        }
+    }
+
+    void clear() noexcept {
+        std::fill(words_.begin(), words_.end(), 0);
+        size_ = 0;
+    }
+
+    //! Same as clear(), but only visits the words of cols, which must be a superset of the
+    //! occupied colors (e.g. the colors listed by TouchedColors)
+    template <typename Colors>
+    void clear(const Colors &cols) noexcept {
+        for (auto col : cols) {
+            assert(col < num_colors_);
+            words_[col / 64] = 0;
+        }
+        size_ = 0;
+    }
+
+    //! Smallest occupied color >= col, or number_of_colors if there is none
+    size_t find_next(size_t col) const noexcept {
+        size_t w = col / 64;
+        if (w >= words_.size())
+            return num_colors_;
+
+        auto word = words_[w] & (~uint64_t{0} << (col % 64));
+        while (!word) {
+            if (++w == words_.size())
+                return num_colors_;
+            word = words_[w];
+        }
+
+        return 64 * w + __builtin_ctzll(word);
+    }
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const size_t *;
+        using reference = size_t;
+
+        const_iterator(const OccupiedColors &colors, size_t col) : colors_(&colors), col_(col) {}
+
+        size_t operator*() const noexcept { return col_; }
+
+        const_iterator &operator++() noexcept {
+            col_ = colors_->find_next(col_ + 1);
+            return *this;
+        }
+
+        const_iterator operator++(int) noexcept {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator &o) const noexcept { return col_ == o.col_; }
+        bool operator!=(const const_iterator &o) const noexcept { return col_ != o.col_; }
+
+    private:
+        const OccupiedColors *colors_;
+        size_t col_;
+    };
+
+    const_iterator begin() const noexcept { return {*this, find_next(0)}; }
+    const_iterator end() const noexcept { return {*this, num_colors_}; }
+
+private:
+    size_t num_colors_;
+    size_t size_{0};
+    std::vector<uint64_t> words_;
+};
+
+} // namespace urns
@@ -0,0 +1,149 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <cassert>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <tlx/define/likely.hpp>
+#include <urns/BoundedUniform.hpp>
+
+namespace urns {
+
+/**
+ * Same as LinearUrn, but the colors are scanned in (roughly) decreasing number of balls.
+ * Whenever the number of balls of a color changes, we compare it with its neighbour in
+ * scan order and swap both if they are out of order (transposition heuristic). Colors that
+ * change often move quickly, so once a protocol converges to few dominant states, these are
+ * found within the first few steps and the expected scan length follows the distribution
+ * of states rather than the number of colors.
+ */
+class SelfOrganizingUrn {
+public:
+    using value_type = int64_t;
+    using color_type = size_t;
+
+    explicit SelfOrganizingUrn(color_type number_of_colors)
+        : balls_(number_of_colors, 0), colors_(number_of_colors), positions_(number_of_colors) {
+        assert(number_of_colors > 0);
+        std::iota(colors_.begin(), colors_.end(), 0);
+        std::iota(positions_.begin(), positions_.end(), 0);
+    }
+
+    void add_balls(color_type col, value_type n = 1) {
+        const auto pos = positions_[col];
+        number_of_balls_ += n;
+        balls_[pos] += n;
+        assert(balls_[pos] >= 0);
+
+        if (n > 0) {
+            move_forward(pos);
+        } else {
+            move_backward(pos);
+        }
+    }
+
+    void remove_balls(color_type col, value_type n) { add_balls(col, -n); }
+
+    template <typename Generator>
+    color_type remove_random_ball(Generator &&gen) noexcept {
+        assert(!empty());
+        auto value = UniformInt<value_type>{0, --number_of_balls_}(gen);
+
+        const auto pos = find(value);
+        const auto col = colors_[pos];
+        --balls_[pos];
+        move_backward(pos);
+        return col;
+    }
+
+    template <typename Generator>
+    color_type get_random_ball(Generator &&gen) const noexcept {
+        assert(!empty());
+        auto value = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
+        return colors_[find(value)];
+    }
+
+    value_type number_of_balls() const noexcept { return number_of_balls_; }
+
+    value_type number_of_balls_with_color(color_type col) const noexcept {
+        return balls_[positions_[col]];
+    }
+
+    color_type number_of_colors() const noexcept { return balls_.size(); }
+
+    bool empty() const noexcept { return !number_of_balls(); }
+
+    template <typename Urn>
+    void add_urn(const Urn &other) {
+        assert(other.number_of_colors() == number_of_colors());
+        for (color_type c = 0; c < number_of_colors(); ++c) {
+            if (const auto n = other.number_of_balls_with_color(c))
+                add_balls(c, n);
+        }
+    }
+
+private:
+    value_type number_of_balls_{0};
+    std::vector<value_type> balls_;   //!< number of balls of the i-th color in scan order
+    std::vector<color_type> colors_;  //!< i-th color in scan order
+    std::vector<size_t> positions_;   //!< inverse of colors_
+
+    size_t find(value_type value) const noexcept {
+        size_t i = 0;
+        while (true) {
+            if (TLX_UNLIKELY(balls_[i] > value))
+                return i;
+            value -= balls_[i];
+            ++i;
+            assert(i < balls_.size());
+        }
+    }
+
+    void swap_positions(size_t a, size_t b) noexcept {
+        std::swap(balls_[a], balls_[b]);
+        std::swap(colors_[a], colors_[b]);
+        positions_[colors_[a]] = a;
+        positions_[colors_[b]] = b;
+    }
+
+    // neighbours are only swapped if they differ by more than a 2^-kHysteresisShift fraction;
+    // otherwise colors of similar size would keep trading places
+    static constexpr unsigned kHysteresisShift = 3;
+
+    static bool clearly_less(value_type a, value_type b) noexcept {
+        return a + (a >> kHysteresisShift) < b;
+    }
+
+    void move_forward(size_t pos) noexcept {
+        if (pos && clearly_less(balls_[pos - 1], balls_[pos]))
+            swap_positions(pos - 1, pos);
+    }
+
+    void move_backward(size_t pos) noexcept {
+        if (pos + 1 < balls_.size() && clearly_less(balls_[pos], balls_[pos + 1]))
+            swap_positions(pos, pos + 1);
+    }
+};
+
+} // namespace urns
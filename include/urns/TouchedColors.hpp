@@ -0,0 +1,81 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace urns {
+
+/**
+ * Keeps track of the colors an urn received balls of since its last clear(). These are a
+ * superset of the colors with balls, so merging or clearing an urn only has to visit them
+ * (and their ancestors in a tree). Once more than a 1/kMaxListedFraction of all colors is
+ * touched, a sweep over all colors is cheaper, and we stop listing them.
+ */
+class TouchedColors {
+public:
+    static constexpr size_t kMaxListedFraction = 16;
+
+    explicit TouchedColors(size_t num_colors)
+        : is_touched_(num_colors, 0), max_listed_(num_colors / kMaxListedFraction) {}
+
+    void touch(size_t col) noexcept {
+        assert(col < is_touched_.size());
+        if (all_ || is_touched_[col])
+            return;
+
+        is_touched_[col] = 1;
+        if (listed_.size() < max_listed_) {
+            listed_.push_back(col);
+        } else {
+            all_ = true;
+        }
+    }
+
+    void touch_all() noexcept { all_ = true; }
+
+    /// If true, any color may have been touched and listed() is incomplete
+    bool all() const noexcept { return all_; }
+
+    const std::vector<size_t> &listed() const noexcept { return listed_; }
+
+    void reset() noexcept {
+        if (all_) {
+            std::fill(is_touched_.begin(), is_touched_.end(), 0);
+        } else {
+            for (auto col : listed_)
+                is_touched_[col] = 0;
+        }
+
+        listed_.clear();
+        all_ = false;
+    }
+
+private:
+    std::vector<uint8_t> is_touched_;
+    std::vector<size_t> listed_;
+    size_t max_listed_;
+    bool all_{false};
+};
+
+} // namespace urns
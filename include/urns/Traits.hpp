@@ -32,5 +32,33 @@ struct has_bulk_insertions {
 template <typename Urn>
 inline constexpr bool has_bulk_insertions_v = has_bulk_insertions<Urn>::value;
 
+// Batched draws, i.e. get_random_balls(gen, colors, num) and remove_random_balls(gen, colors, num)
+template <typename Urn>
+struct has_batched_draws {
+    static constexpr bool value = false;
+};
+
+template <typename Urn>
+inline constexpr bool has_batched_draws_v = has_batched_draws<Urn>::value;
+
+// Index of the non-empty colors, i.e. occupied_colors() returning an OccupiedColors
+template <typename Urn>
+struct has_occupied_colors {
+    static constexpr bool value = false;
+};
+
+template <typename Urn>
+inline constexpr bool has_occupied_colors_v = has_occupied_colors<Urn>::value;
+
+// Fused interaction, i.e. replace_random_pair(gen, transition) drawing two distinct balls (a, b)
+// and replacing them by balls of colors transition(a, b)
+template <typename Urn>
+struct has_pair_replacement {
+    static constexpr bool value = false;
+};
+
+template <typename Urn>
+inline constexpr bool has_pair_replacement_v = has_pair_replacement<Urn>::value;
+
 } // namespace traits
 } // namespace urns
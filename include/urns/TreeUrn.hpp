@@ -19,10 +19,17 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <random>
 #include <vector>
-#include <sampling/hypergeometric_distribution.hpp>
+#include <sampling/multivariate_hypergeometric.hpp>
 #include <tlx/math.hpp>
+#include <urns/BoundedUniform.hpp>
+#include <urns/TouchedColors.hpp>
+#include <urns/OccupiedColors.hpp>
+#include <urns/Traits.hpp>
 
 namespace urns {
 
@@ -31,11 +38,15 @@ public:
     using value_type = int64_t;
     using color_type = size_t;
 
+    //! Number of walks get_random_balls / remove_random_balls advance in lockstep
+    static constexpr size_t kBatchedDraws = 16;
+
     explicit TreeUrn(color_type number_of_colors)
         : number_of_colors_(number_of_colors),
           first_leaf_(tlx::round_up_to_power_of_two(number_of_colors_)),
           tree_storage_(first_leaf_ + number_of_colors, 0),
-          balls_with_color_(std::addressof(tree_storage_[first_leaf_ - 1])) {
+          balls_with_color_(std::addressof(tree_storage_[first_leaf_ - 1])),
+          touched_(number_of_colors), occupied_(number_of_colors) {
         tree_1indexed_ = tree_storage_.data() - 1;
     }
 
@@ -60,7 +71,10 @@ public:
             step();
         } while (i > 1);
 
+        const auto old_num = balls_with_color_[col];
         balls_with_color_[col] += n;
+        touched_.touch(col);
+        occupied_.update(col, old_num, balls_with_color_[col]);
     }
 
     void set_balls(color_type col, value_type n) {
@@ -72,7 +86,7 @@ public:
     template <typename Generator>
     std::pair<color_type, value_type> remove_random_ball_with_index(Generator &&gen) noexcept {
         assert(!empty());
-        auto value = std::uniform_int_distribution<value_type>{0, number_of_balls_ - 1}(gen);
+        auto value = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
 
         size_t i = 1;
 
@@ -98,7 +112,8 @@ public:
 
         --number_of_balls_;
         const auto col = i - first_leaf_;
-        balls_with_color_[col]--;
+        if (!--balls_with_color_[col])
+            occupied_.erase(col);
 
         return {col, value};
     }
@@ -111,7 +126,7 @@ public:
     template <typename Generator>
     std::pair<color_type, value_type> get_random_ball_with_index(Generator &&gen) const noexcept {
         assert(!empty());
-        auto value = std::uniform_int_distribution<value_type>{0, number_of_balls_ - 1}(gen);
+        auto value = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
 
         size_t i = 1;
         do {
@@ -141,12 +156,85 @@ public:
         return get_random_ball_with_index(std::forward<Generator>(gen)).first;
     }
 
+    /**
+     * Draws num balls with replacement and stores their colors in colors[0, num).
+     * Up to kBatchedDraws root-to-leaf walks are carried out level by level, and each
+     * walk prefetches its next node, so the cache misses of independent walks overlap.
+     */
+    template <typename Generator>
+    void get_random_balls(Generator &gen, color_type *colors, size_t num) const noexcept {
+        batched_walks<false>(static_cast<const value_type *>(tree_1indexed_), gen, colors, num);
+    }
+
+    /**
+     * Same as num calls to remove_random_ball (and yields identical results for the same
+     * generator state). Walks of a batch go down the tree level by level in drawing order,
+     * so each walk sees the decrements of all earlier walks on every node it reads.
+     */
+    template <typename Generator>
+    void remove_random_balls(Generator &gen, color_type *colors, size_t num) noexcept {
+        assert(static_cast<value_type>(num) <= number_of_balls_);
+        batched_walks<true>(tree_1indexed_, gen, colors, num);
+        number_of_balls_ -= num;
+
+        // a color drawn several times is emptied only once
+        for (size_t i = 0; i < num; ++i) {
+            if (!balls_with_color_[colors[i]] && occupied_.contains(colors[i]))
+                occupied_.erase(colors[i]);
+        }
+    }
+
+    /**
+     * Draws two distinct balls of colors (a, b) and replaces them by balls of the colors
+     * (c, d) = transition(a, b). Both walks are carried out simultaneously and share the nodes
+     * of their common prefix. Moving a ball from a to c only changes the nodes below the lowest
+     * common ancestor of both leaves (and nothing at all if c == a). This replaces the four
+     * root-to-leaf passes of two removals and two insertions by two read-only walks and the
+     * updates of agents that actually change their state.
+     */
+    template <typename Generator, typename Transition>
+    void replace_random_pair(Generator &gen, Transition &&transition) {
+        assert(number_of_balls_ > 1);
+
+        // the second ball is drawn among all balls except the first one
+        const auto first = UniformInt<value_type>{0, number_of_balls_ - 1}(gen);
+        auto second = UniformInt<value_type>{0, number_of_balls_ - 2}(gen);
+        second += (second >= first);
+
+        // all leaves have the same depth, so both walks stay in lockstep; while they share
+        // their path, the second walk reads the node the first one just loaded
+        auto values = std::array<value_type, 2>{first, second};
+        auto nodes = std::array<size_t, 2>{1, 1};
+        for (size_t level = first_leaf_; level > 1; level /= 2) {
+            for (size_t w = 0; w < 2; ++w) {
+                const auto leftWeight = tree_1indexed_[nodes[w]];
+                const auto toRight = (values[w] >= leftWeight);
+                values[w] -= toRight * leftWeight;
+                nodes[w] = 2 * nodes[w] + toRight;
+            }
+        }
+
+        const auto old_first = nodes[0] - first_leaf_;
+        const auto old_second = nodes[1] - first_leaf_;
+        const auto [new_first, new_second] = transition(old_first, old_second);
+
+        move_ball(old_first, new_first);
+        move_ball(old_second, new_second);
+    }
+
     value_type number_of_balls_with_color(color_type col) const noexcept {
         return balls_with_color_[col];
     }
 
     value_type number_of_balls() const noexcept { return number_of_balls_; }
 
+    //! Contiguous array of number_of_colors() counts,
+    //! i.e. data()[i] == number_of_balls_with_color(i)
+    const value_type *data() const noexcept { return balls_with_color_; }
+
+    //! Colors with at least one ball; iterating them visits the colors in increasing order
+    const OccupiedColors &occupied_colors() const noexcept { return occupied_; }
+
     color_type number_of_colors() const noexcept { return number_of_colors_; }
 
     bool empty() const noexcept { return !number_of_balls(); }
@@ -154,78 +242,111 @@ public:
     template <typename Urn>
     void add_urn(const Urn &other) {
         assert(other.number_of_colors() == number_of_colors());
-        for (color_type c = 0; c < number_of_colors(); ++c)
-            balls_with_color_[c] += other.number_of_balls_with_color(c);
+        for (color_type c = 0; c < number_of_colors(); ++c) {
+            const auto n = other.number_of_balls_with_color(c);
+            if (n) {
+                occupied_.update(c, balls_with_color_[c], balls_with_color_[c] + n);
+                balls_with_color_[c] += n;
+                touched_.touch(c);
+            }
+        }
 
         number_of_balls_ += other.number_of_balls();
         build_tree_from_balls();
     }
 
+    //! Takes time O(t log k) if other was touched at t < k / TouchedColors::kMaxListedFraction
+    //! colors since its last clear(), and O(k) otherwise
     void add_urn(const TreeUrn &other) {
         assert(other.number_of_colors() == number_of_colors());
 
+        if (!other.touched_.all()) {
+            for (auto col : other.touched_.listed()) {
+                if (const auto n = other.number_of_balls_with_color(col))
+                    add_balls(col, n);
+            }
+            return;
+        }
+
         auto reader = other.tree_storage_.cbegin();
         for (auto &writer : tree_storage_)
             writer += *(reader++);
 
         number_of_balls_ += other.number_of_balls();
+        touched_.touch_all();
+        occupied_.assign(balls_with_color_);
     }
 
+    //! Takes time O(t log k) if only t < k / TouchedColors::kMaxListedFraction colors were
+    //! touched since the last clear(), and O(k) otherwise
     void clear() {
         number_of_balls_ = 0;
-        std::fill(tree_storage_.begin(), tree_storage_.end(), 0);
+
+        if (touched_.all()) {
+            std::fill(tree_storage_.begin(), tree_storage_.end(), 0);
+            occupied_.clear();
+        } else {
+            // only the paths from touched leaves to the root may hold balls
+            for (auto col : touched_.listed()) {
+                for (auto i = first_leaf_ + col; i; i /= 2)
+                    tree_1indexed_[i] = 0;
+            }
+            occupied_.clear(touched_.listed());
+        }
+
+        touched_.reset();
     }
 
-    // sample frequencies
+    /**
+     * Samples num_of_samples balls without replacement and calls cb(color, num) for each color
+     * in increasing order (if CallOnEmpty also for colors not sampled). We split the samples
+     * top-down between the two subtrees of a node with one hypergeometric variate and prune
+     * subtrees that receive no samples. Hence, without CallOnEmpty, the costs are proportional
+     * to the number of sampled colors times log(number_of_colors()) rather than linear in
+     * the number of colors. If almost all colors are hit anyhow, a linear scan is faster.
+     */
     template <bool CallOnEmpty, typename Gen, typename Callback>
     void sample_without_replacement(const value_type num_of_samples, Gen &gen,
                                     Callback &&cb) const {
         if (TLX_UNLIKELY(!number_of_balls() || !num_of_samples))
             return;
 
-        sampling::hypergeometric_distribution<Gen, value_type> hpd(gen);
-
-        auto left_to_sample = num_of_samples;
-        auto unconsidered_balls = static_cast<double>(number_of_balls());
-
-        auto it_from = balls_with_color_;
-        const auto *balls_end = balls_with_color_ + number_of_colors();
-
-        while (left_to_sample) {
-            assert(it_from != balls_end);
-            const auto balls_with_color = *it_from;
-            unconsidered_balls -= balls_with_color;
-            const auto num_selected = [&]() -> size_t {
-                if (!balls_with_color)
-                    return 0;
+        assert(num_of_samples <= number_of_balls());
+        sampling::multivariate_hypergeometric<Gen, value_type> mvh(gen);
 
-                if (!unconsidered_balls)
-                    return std::min(left_to_sample, balls_with_color);
-
-                return hpd(balls_with_color, unconsidered_balls, left_to_sample);
-            }();
-
-            if (CallOnEmpty || num_selected)
-                cb(static_cast<color_type>(it_from - balls_with_color_), num_selected);
-
-            left_to_sample -= num_selected;
-            it_from++;
-        }
-
-        if (CallOnEmpty) {
-            for (; it_from != balls_end; ++it_from)
-                cb(static_cast<color_type>(it_from - balls_with_color_), 0);
+        if (is_dense_sample(num_of_samples)) {
+            sample_linear<CallOnEmpty>(mvh, num_of_samples, cb);
+        } else {
+            sample_subtree<false, CallOnEmpty>(static_cast<const value_type *>(tree_1indexed_),
+                                               mvh, 1, first_leaf_, number_of_balls(),
+                                               num_of_samples, cb);
         }
     }
 
     /// Same as sample_without_replacement, but actually removes balls from urn
     template <bool CallOnEmpty, typename Gen, typename Callback>
     void remove_random_balls(const value_type num_of_samples, Gen &gen, Callback &&cb) {
-        sample_without_replacement<CallOnEmpty>(num_of_samples, gen,
-                                                [&](color_type color, value_type num) {
-                                                    remove_balls(color, num);
-                                                    cb(color, num);
-                                                });
+        if (TLX_UNLIKELY(!number_of_balls() || !num_of_samples))
+            return;
+
+        assert(num_of_samples <= number_of_balls());
+        sampling::multivariate_hypergeometric<Gen, value_type> mvh(gen);
+
+        if (is_dense_sample(num_of_samples)) {
+            sample_linear<CallOnEmpty>(mvh, num_of_samples, [&](color_type color, value_type num) {
+                remove_balls(color, num);
+                cb(color, num);
+            });
+        } else {
+            auto remove_cb = [&](color_type color, value_type num) {
+                if (num && !balls_with_color_[color])
+                    occupied_.erase(color);
+                cb(color, num);
+            };
+            sample_subtree<true, CallOnEmpty>(tree_1indexed_, mvh, 1, first_leaf_,
+                                              number_of_balls(), num_of_samples, remove_cb);
+            number_of_balls_ -= num_of_samples;
+        }
     }
 
 private:
@@ -238,6 +359,143 @@ private:
     value_type *tree_1indexed_;
     value_type *balls_with_color_;
 
+    TouchedColors touched_; //!< superset of the colors with balls
+    OccupiedColors occupied_;
+
+    //! Moves a ball from color from to color to. Both paths meet in their lowest common
+    //! ancestor; above it, both updates hit the same node and cancel out. We still walk up to
+    //! the root, as stopping at the ancestor costs a mispredicted branch per call, which is
+    //! more expensive than the updates of the (cached) shared prefix.
+    void move_ball(color_type from, color_type to) {
+        if (from == to)
+            return;
+
+        assert(balls_with_color_[from] > 0);
+        auto i = first_leaf_ + from;
+        auto j = first_leaf_ + to;
+        for (size_t level = first_leaf_; level > 1; level /= 2) {
+            tree_1indexed_[i / 2] -= !(i & 1);
+            tree_1indexed_[j / 2] += !(j & 1);
+            i /= 2;
+            j /= 2;
+        }
+
+        if (!--balls_with_color_[from])
+            occupied_.erase(from);
+        if (!balls_with_color_[to]++)
+            occupied_.insert(to);
+        touched_.touch(to);
+    }
+
+    template <bool Remove, typename Tree, typename Generator>
+    void batched_walks(Tree tree, Generator &gen, color_type *colors, size_t num) const noexcept {
+        std::array<value_type, kBatchedDraws> values;
+        std::array<size_t, kBatchedDraws> nodes;
+
+        auto balls = number_of_balls_;
+        while (num) {
+            const auto batch = std::min(num, kBatchedDraws);
+
+            for (size_t w = 0; w < batch; ++w) {
+                values[w] = UniformInt<value_type>{0, balls - 1}(gen);
+                balls -= Remove;
+                nodes[w] = 1;
+            }
+
+            // all leaves have the same depth, so the walks stay in lockstep
+            for (size_t level = first_leaf_; level > 1; level /= 2) {
+                for (size_t w = 0; w < batch; ++w) {
+                    auto &leftWeight = tree[nodes[w]];
+
+                    const auto toRight = (values[w] >= leftWeight);
+                    values[w] -= toRight * leftWeight;
+                    if constexpr (Remove)
+                        leftWeight -= !toRight;
+
+                    nodes[w] = 2 * nodes[w] + toRight;
+                    __builtin_prefetch(tree + nodes[w]);
+                }
+            }
+
+            // leaves are not read by the walks, so we update them last
+            for (size_t w = 0; w < batch; ++w) {
+                colors[w] = nodes[w] - first_leaf_;
+                if constexpr (Remove)
+                    tree[nodes[w]]--;
+            }
+
+            colors += batch;
+            num -= batch;
+        }
+    }
+
+    //! Samples per color from which on we prefer the linear scan
+    static constexpr value_type kDenseSamplesPerColor = 32;
+
+    bool is_dense_sample(value_type num_of_samples) const noexcept {
+        return num_of_samples >= kDenseSamplesPerColor * static_cast<value_type>(number_of_colors_);
+    }
+
+    template <bool CallOnEmpty, typename Mvh, typename Callback>
+    void sample_linear(Mvh &mvh, const value_type num_of_samples, Callback &&cb) const {
+        auto split = mvh.start(number_of_balls(), num_of_samples);
+
+        // unless we have to report empty colors, we skip empty ones if there are many; as cb
+        // may remove the balls of the current color, we advance based on the color index
+        const bool skip_empty = !CallOnEmpty && 4 * occupied_.size() < number_of_colors();
+        auto next_color = [&](color_type c) {
+            return skip_empty ? occupied_.find_next(c + 1) : c + 1;
+        };
+
+        color_type col = skip_empty ? occupied_.find_next(0) : 0;
+        for (; split.left_to_sample(); col = next_color(col)) {
+            assert(col < number_of_colors());
+            const auto num_selected = split(balls_with_color_[col]);
+
+            if (CallOnEmpty || num_selected)
+                cb(col, num_selected);
+        }
+
+        if (CallOnEmpty) {
+            for (; col < number_of_colors(); ++col)
+                cb(col, 0);
+        }
+    }
+
+    /// Distributes samples among the colors [node * width - first_leaf_, +width) of the
+    /// subtree rooted in node, which contains total balls; if Remove, the balls are removed
+    template <bool Remove, bool CallOnEmpty, typename Tree, typename Mvh, typename Callback>
+    void sample_subtree(Tree tree, Mvh &mvh, size_t node, size_t width, value_type total,
+                        value_type samples, Callback &cb) const {
+        if (!samples) {
+            if constexpr (CallOnEmpty) {
+                const auto begin = node * width - first_leaf_;
+                const auto end = std::min(begin + width, number_of_colors_);
+                for (auto col = begin; col < end; ++col)
+                    cb(static_cast<color_type>(col), value_type{0});
+            }
+            return;
+        }
+
+        if (node >= first_leaf_) {
+            if constexpr (Remove)
+                tree[node] -= samples;
+            cb(static_cast<color_type>(node - first_leaf_), samples);
+            return;
+        }
+
+        const auto left = tree[node];
+        const auto right = total - left;
+        const auto to_left = mvh.split(left, right, samples);
+
+        if constexpr (Remove)
+            tree[node] -= to_left;
+
+        sample_subtree<Remove, CallOnEmpty>(tree, mvh, 2 * node, width / 2, left, to_left, cb);
+        sample_subtree<Remove, CallOnEmpty>(tree, mvh, 2 * node + 1, width / 2, right,
+                                            samples - to_left, cb);
+    }
+
     void build_tree_from_balls() {
         std::fill(tree_storage_.data(), balls_with_color_, 0);
 
@@ -251,4 +509,22 @@ private:
     }
 };
 
+namespace traits {
+
+template <>
+struct has_batched_draws<TreeUrn> {
+    static constexpr bool value = true;
+};
+
+template <>
+struct has_occupied_colors<TreeUrn> {
+    static constexpr bool value = true;
+};
+
+template <>
+struct has_pair_replacement<TreeUrn> {
+    static constexpr bool value = true;
+};
+
+} // namespace traits
 } // namespace urns
\ No newline at end of file
@@ -22,11 +22,16 @@
 #include <optional>
 
 #include <string>
+#include <thread>
 
 #include <tlx/cmdline_parser.hpp>
 
+#include <urns/AdaptiveUrn.hpp>
 #include <urns/AliasUrnSimple.hpp>
+#include <urns/BAryTreeUrn.hpp>
+#include <urns/BucketUrn.hpp>
 #include <urns/LinearUrn.hpp>
+#include <urns/SelfOrganizingUrn.hpp>
 
 #include <pps/AsyncBatchSimulator.hpp>
 #include <pps/AsyncDistributionSimulator.hpp>
@@ -41,12 +46,22 @@ struct Configuration {
     enum class Simulator {
         Batch,
         BatchTree,
+        BatchBAryTree,
+        BatchAdaptive,
+        BatchParallel,
+        BatchPipelined,
         Population,
         Population4,
         Population8,
+        PopulationAdaptive,
+        PopulationParallel,
         DistrLinear,
+        DistrSelfOrganizing,
         DistrTree,
-        DistrAlias
+        DistrBAryTree,
+        DistrAlias,
+        DistrBucket,
+        DistrAdaptive
     };
 
     size_t num_agents{1'024};
@@ -56,6 +71,7 @@ struct Configuration {
     pps::state_t num_states{20};
     size_t num_rounds{10};
     unsigned num_repeats{1};
+    unsigned num_threads{std::thread::hardware_concurrency()};
 
     std::string simulator_name{"batch"};
     std::string protocol_name{"random1"};
@@ -71,6 +87,8 @@ struct Configuration {
         auto sim_name = simulator_name;
         if (sim_name == "distr-alias")
             sim_name = "distr-alias-fixed";
+        if (simulator == Simulator::BatchParallel || simulator == Simulator::PopulationParallel)
+            sim_name += std::to_string(num_threads);
 
         ss << sim_name << ',' << protocol_name << ',' << num_agents << ',' << num_states << ','
            << num_rounds << ',' << seed;
@@ -83,7 +101,10 @@ struct Configuration {
 
         parser.add_unsigned('s', "seed", config.seed, "Seed value");
         parser.add_string('a', "simulator", config.simulator_name,
-                          "Simulator: batch, pop, pop4, pop8, distr-linear, distr-alias");
+                          "Simulator: batch, batch-tree, batch-btree, batch-adaptive, batch-par, "
+                          "batch-pipe, pop, pop4, pop8, pop-auto, pop-par, "
+                          "distr-linear, distr-selforg, distr-tree, distr-btree, distr-alias, "
+                          "distr-bucket, distr-adaptive");
         parser.add_string('p', "protocol", config.protocol_name, "Protocol: random, clock");
 
         parser.add_size_t('n', "agents", config.num_agents, "Number of agents");
@@ -94,6 +115,8 @@ struct Configuration {
 
         parser.add_size_t('r', "rounds", config.num_rounds, "Number of rounds");
         parser.add_uint('R', "repeats", config.num_repeats, "Number of repeats");
+        parser.add_unsigned('T', "threads", config.num_threads,
+                            "Number of threads used by parallel simulators");
 
         parser.add_flag("header-only", config.print_header_only, "Print CSV header and quit");
 
@@ -105,18 +128,38 @@ struct Configuration {
             config.simulator = Simulator::Batch;
         else if (config.simulator_name == "batch-tree")
             config.simulator = Simulator::BatchTree;
+        else if (config.simulator_name == "batch-btree")
+            config.simulator = Simulator::BatchBAryTree;
+        else if (config.simulator_name == "batch-adaptive")
+            config.simulator = Simulator::BatchAdaptive;
+        else if (config.simulator_name == "batch-par")
+            config.simulator = Simulator::BatchParallel;
+        else if (config.simulator_name == "batch-pipe")
+            config.simulator = Simulator::BatchPipelined;
         else if (config.simulator_name == "pop")
             config.simulator = Simulator::Population;
         else if (config.simulator_name == "pop4")
             config.simulator = Simulator::Population4;
         else if (config.simulator_name == "pop8")
             config.simulator = Simulator::Population8;
+        else if (config.simulator_name == "pop-auto")
+            config.simulator = Simulator::PopulationAdaptive;
+        else if (config.simulator_name == "pop-par")
+            config.simulator = Simulator::PopulationParallel;
         else if (config.simulator_name == "distr-linear")
             config.simulator = Simulator::DistrLinear;
+        else if (config.simulator_name == "distr-selforg")
+            config.simulator = Simulator::DistrSelfOrganizing;
         else if (config.simulator_name == "distr-tree")
             config.simulator = Simulator::DistrTree;
+        else if (config.simulator_name == "distr-btree")
+            config.simulator = Simulator::DistrBAryTree;
         else if (config.simulator_name == "distr-alias")
             config.simulator = Simulator::DistrAlias;
+        else if (config.simulator_name == "distr-bucket")
+            config.simulator = Simulator::DistrBucket;
+        else if (config.simulator_name == "distr-adaptive")
+            config.simulator = Simulator::DistrAdaptive;
         else {
             std::cout << "Unknown simulator >" << config.simulator_name << "<\n";
             return {};
@@ -137,6 +180,7 @@ struct Configuration {
 
         die_verbose_unless(config.num_agents > 1, "Need at least two agents");
         die_verbose_unless(config.num_states > 1, "Need at least two states");
+        die_verbose_unless(config.num_threads > 0, "Need at least one thread");
 
         return config;
     }
@@ -165,6 +209,46 @@ double measure_single_run(const Configuration &config, std::mt19937_64 &prng) {
         };
 
         using Protocol = decltype(protocol);
+
+        // store agents with as few bits as possible
+        auto with_bits_per_state = [&](auto callback) -> double {
+            switch (pps::bits_per_state(urn.number_of_colors())) {
+            case 1:
+                return callback(std::integral_constant<unsigned, 1>{});
+            case 2:
+                return callback(std::integral_constant<unsigned, 2>{});
+            case 4:
+                return callback(std::integral_constant<unsigned, 4>{});
+            case 8:
+                return callback(std::integral_constant<unsigned, 8>{});
+            case 16:
+                return callback(std::integral_constant<unsigned, 16>{});
+            default:
+                return callback(std::integral_constant<unsigned, 32>{});
+            }
+        };
+
+        auto run_population = [&](auto prefetch, unsigned num_threads = 1) -> double {
+            return with_bits_per_state([&](auto bits) {
+                return run(pps::AsyncPopulationSimulator<decltype(prefetch)::value, Protocol,
+                                                         std::mt19937_64, decltype(bits)::value>(
+                    urn, protocol, prng, num_threads));
+            });
+        };
+
+        // 32 bit counts halve the height of the B-ary tree, but only suffice for < 2^32 agents
+        auto with_bary_tree_urn = [&](auto callback) -> double {
+            if (urn.number_of_balls() < (int64_t{1} << 32)) {
+                urns::BAryTreeUrn<uint32_t> new_urn(urn.number_of_colors());
+                convert_urn(new_urn);
+                return callback(new_urn);
+            } else {
+                urns::BAryTreeUrn<uint64_t> new_urn(urn.number_of_colors());
+                convert_urn(new_urn);
+                return callback(new_urn);
+            }
+        };
+
         switch (config.simulator) {
         case Configuration::Simulator::Batch:
             return run(pps::AsyncBatchSimulator(urn, protocol, prng));
@@ -173,30 +257,63 @@ double measure_single_run(const Configuration &config, std::mt19937_64 &prng) {
             convert_urn(new_urn);
             return run(pps::AsyncBatchSimulator(new_urn, protocol, prng));
         }
+        case Configuration::Simulator::BatchBAryTree:
+            return with_bary_tree_urn([&](auto &new_urn) {
+                return run(pps::AsyncBatchSimulator(new_urn, protocol, prng));
+            });
+        case Configuration::Simulator::BatchAdaptive: {
+            urns::AdaptiveUrn new_urn(urn.number_of_colors());
+            convert_urn(new_urn);
+            return run(pps::AsyncBatchSimulator(new_urn, protocol, prng));
+        }
+        case Configuration::Simulator::BatchParallel:
+            return run(pps::AsyncBatchSimulator(urn, protocol, prng, config.num_threads));
+        case Configuration::Simulator::BatchPipelined:
+            return run(pps::AsyncBatchSimulator(urn, protocol, prng, 1, true));
         case Configuration::Simulator::Population:
-            return run(
-                pps::AsyncPopulationSimulator<0, Protocol, std::mt19937_64>(urn, protocol, prng));
+            return run_population(std::integral_constant<size_t, 0>{});
         case Configuration::Simulator::Population4:
-            return run(
-                pps::AsyncPopulationSimulator<4, Protocol, std::mt19937_64>(urn, protocol, prng));
+            return run_population(std::integral_constant<size_t, 4>{});
         case Configuration::Simulator::Population8:
-            return run(
-                pps::AsyncPopulationSimulator<8, Protocol, std::mt19937_64>(urn, protocol, prng));
+            return run_population(std::integral_constant<size_t, 8>{});
+        case Configuration::Simulator::PopulationAdaptive:
+            return run_population(std::integral_constant<size_t, pps::kAdaptivePrefetch>{});
+        case Configuration::Simulator::PopulationParallel:
+            return run_population(std::integral_constant<size_t, 4>{}, config.num_threads);
         case Configuration::Simulator::DistrLinear: {
             urns::LinearUrn new_urn(urn.number_of_colors());
             convert_urn(new_urn);
             return run(pps::AsyncDistributionSimulator(new_urn, protocol, prng));
         }
+        case Configuration::Simulator::DistrSelfOrganizing: {
+            urns::SelfOrganizingUrn new_urn(urn.number_of_colors());
+            convert_urn(new_urn);
+            return run(pps::AsyncDistributionSimulator(new_urn, protocol, prng));
+        }
         case Configuration::Simulator::DistrTree: {
             urns::TreeUrn new_urn(urn.number_of_colors());
             convert_urn(new_urn);
             return run(pps::AsyncDistributionSimulator(new_urn, protocol, prng));
         }
+        case Configuration::Simulator::DistrBAryTree:
+            return with_bary_tree_urn([&](auto &new_urn) {
+                return run(pps::AsyncDistributionSimulator(new_urn, protocol, prng));
+            });
         case Configuration::Simulator::DistrAlias: {
             urns::AliasUrnSimple new_urn(urn.number_of_colors());
             convert_urn(new_urn);
             return run(pps::AsyncDistributionSimulator(new_urn, protocol, prng));
         }
+        case Configuration::Simulator::DistrBucket: {
+            urns::BucketUrn new_urn(urn.number_of_colors());
+            convert_urn(new_urn);
+            return run(pps::AsyncDistributionSimulator(new_urn, protocol, prng));
+        }
+        case Configuration::Simulator::DistrAdaptive: {
+            urns::AdaptiveUrn new_urn(urn.number_of_colors());
+            convert_urn(new_urn);
+            return run(pps::AsyncDistributionSimulator(new_urn, protocol, prng));
+        }
         default:
             abort();
         }
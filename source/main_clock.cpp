@@ -157,8 +157,9 @@ int main(int argc, char *argv[]) {
     auto report = [&](const auto &sim, auto &&) {
         print_histogram(config, sim);
 
-        // const auto max_gap = prot.compute_max_gap(sim.agents(), gap_threshold);
-        // std::cout << "Max gap: " << max_gap << "\n";
+        // only visits the occupied states, so we can afford it even for large clocks
+        const auto max_gap = sim.protocol().compute_max_gap(sim.agents(), gap_threshold);
+        std::cout << "Max gap: " << max_gap << "\n";
     };
 
     // Invoke simulator
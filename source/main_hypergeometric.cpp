@@ -0,0 +1,121 @@
+/**
+ * @author Manuel Penschuck
+ * @copyright
+ * Copyright (C) 2019 Manuel Penschuck
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <tlx/cmdline_parser.hpp>
+
+#include <sampling/fast_hypergeometric_distribution.hpp>
+#include <sampling/hypergeometric_distribution.hpp>
+
+/*
+ * Compares hypergeometric_distribution with fast_hypergeometric_distribution (exact and with
+ * binomial approximation). Besides single parameter sets, we split a sample among equally
+ * sized colors as the batch simulator and the urns do. Output is CSV with ns per variate.
+ */
+int main(int argc, char *argv[]) {
+    tlx::CmdlineParser parser;
+
+    unsigned seed = std::random_device{}();
+    size_t num_variates = 1'000'000;
+    double max_binomial_error = 0.01;
+
+    parser.add_unsigned('s', "seed", seed, "Seed value");
+    parser.add_size_t('n', "variates", num_variates, "Number of variates per measurement");
+    parser.add_double('e', "binomial-error", max_binomial_error,
+                      "Max. total variation distance of the binomial approximation");
+
+    if (!parser.process(argc, argv))
+        return -1;
+
+    std::mt19937_64 prng(seed);
+
+    // returns the time per variate in ns
+    auto measure = [&](auto &distr, auto &&draw) {
+        int64_t sum = 0;
+        size_t variates = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+        while (variates < num_variates)
+            variates += draw(distr, sum);
+        const auto stop = std::chrono::steady_clock::now();
+
+        // keep the compiler from dropping the variates
+        if (sum == 42)
+            std::cout << "";
+
+        return std::chrono::duration<double, std::nano>(stop - start).count() / variates;
+    };
+
+    auto compare = [&](const std::string &name, auto &&draw) {
+        sampling::hypergeometric_distribution<std::mt19937_64> reference(prng);
+        sampling::fast_hypergeometric_distribution<std::mt19937_64> fast(prng);
+        sampling::fast_hypergeometric_distribution<std::mt19937_64> binomial(prng,
+                                                                             max_binomial_error);
+
+        std::cout << name << ',' << measure(reference, draw) << ',' << measure(fast, draw) << ','
+                  << measure(binomial, draw) << std::endl;
+    };
+
+    std::cout << "params,reference,fast,binomial\n";
+
+    const std::vector<std::tuple<int64_t, int64_t, int64_t>> single_params{
+        {50, 950, 8},           {500, 9500, 10},         {500, 9500, 100},
+        {100, 900, 500},        {10000, 990000, 1000},   {1000000, 99000000, 10000},
+        {1000, 999999000, 31622}, {50000000, 50000000, 30000000}};
+
+    for (const auto &[good, bad, sample] : single_params) {
+        compare("single-" + std::to_string(good) + "-" + std::to_string(bad) + "-" +
+                    std::to_string(sample),
+                [good = good, bad = bad, sample = sample](auto &distr, int64_t &sum) -> size_t {
+                    sum += distr(good, bad, sample);
+                    return 1;
+                });
+    }
+
+    const std::vector<std::tuple<int64_t, int64_t, int64_t>> split_params{
+        {1000000, 20, 1000}, {100000000, 20, 10000}, {100000000, 1000, 10000}};
+
+    for (const auto &[num_balls, num_colors, sample] : split_params) {
+        compare("split-" + std::to_string(num_balls) + "-" + std::to_string(num_colors) + "-" +
+                    std::to_string(sample),
+                [num_balls = num_balls, num_colors = num_colors,
+                 sample = sample](auto &distr, int64_t &sum) -> size_t {
+                    const auto balls_per_color = num_balls / num_colors;
+                    auto unconsidered = num_balls;
+                    auto left = sample;
+                    size_t variates = 0;
+                    for (int64_t c = 0; c + 1 < num_colors && left; ++c, ++variates) {
+                        unconsidered -= balls_per_color;
+                        const auto x = distr(balls_per_color, unconsidered, left);
+                        left -= x;
+                        sum += x;
+                    }
+                    return variates;
+                });
+    }
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <cmath>
+#include <gtest/gtest.h>
+
+#include <pps/AsyncBatchSimulator.hpp>
+
+// Agents in state 0 neither act nor are acted upon, so the batch simulator skips them as
+// partners. Any other partner is decremented (or reset to 0), which lowers the sum of all
+// states; the rate of this decrease reveals if skipped partners are over-represented.
+template <bool Reset>
+struct DecrementPartnerProtocol : public pps::Protocols::DeterministicProtocol {
+    pps::state_pair_t operator()(pps::state_t first, pps::state_t second) const noexcept {
+        if (!first || !second)
+            return {first, second};
+        return {first, Reset ? 0 : second - 1};
+    }
+};
+
+// Decrease of the sum of all states per interaction averaged over several runs
+template <typename Protocol>
+double decrease_per_interaction(unsigned num_threads, unsigned seed) {
+    constexpr size_t kNumStates = 64;
+    constexpr size_t kAgentsPerState = 2000;
+    constexpr size_t kNumRuns = 10;
+
+    auto state_sum = [](const pps::WeightedUrn &urn) {
+        size_t sum = 0;
+        for (pps::state_t i = 1; i < urn.number_of_colors(); ++i)
+            sum += i * urn.number_of_balls_with_color(i);
+        return sum;
+    };
+
+    std::mt19937_64 gen(seed);
+    size_t decrease = 0;
+    size_t interactions = 0;
+    for (size_t r = 0; r < kNumRuns; ++r) {
+        pps::WeightedUrn initial_urn(kNumStates);
+        for (pps::state_t i = 0; i < kNumStates; ++i)
+            initial_urn.add_balls(i, kAgentsPerState);
+
+        pps::AsyncBatchSimulator<Protocol, std::mt19937_64> simulator(initial_urn, Protocol{},
+                                                                      gen, num_threads);
+
+        simulator.run([&](const auto &sim) {
+            return sim.num_interactions() < kNumStates * kAgentsPerState;
+        });
+
+        decrease += state_sum(initial_urn) - state_sum(simulator.agents());
+        interactions += simulator.num_interactions();
+    }
+
+    return static_cast<double>(decrease) / interactions;
+}
+
+template <typename Protocol>
+void compare_sequential_and_parallel() {
+    const auto sequential = decrease_per_interaction<Protocol>(1, 1);
+    const auto parallel = decrease_per_interaction<Protocol>(4, 2);
+    EXPECT_NEAR(parallel / sequential, 1.0, 0.005) << sequential << " " << parallel;
+}
+
+TEST(BatchSimulatorParallel, Pairwise) {
+    compare_sequential_and_parallel<DecrementPartnerProtocol<false>>();
+}
+
+TEST(BatchSimulatorParallel, Partitioned) {
+    compare_sequential_and_parallel<DecrementPartnerProtocol<true>>();
+}
@@ -0,0 +1,84 @@
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <urns/BoundedUniform.hpp>
+
+// chi^2 test of the counts of distr(gen) - a against a uniform distribution on [a, b]
+template <typename T, typename Gen>
+static void check_uniform(Gen& gen, T a, T b) {
+    urns::BoundedUniform<T> distr(a, b);
+    const auto size = static_cast<size_t>(b - a) + 1;
+
+    const size_t samples = 2000 * size;
+    std::vector<size_t> counts(size);
+    for(size_t i = 0; i < samples; ++i) {
+        const auto x = distr(gen);
+        ASSERT_GE(x, a);
+        ASSERT_LE(x, b);
+        counts[static_cast<size_t>(x - a)]++;
+    }
+
+    const auto expected = static_cast<double>(samples) / size;
+    double chi2 = 0.0;
+    for(auto c : counts)
+        chi2 += (c - expected) * (c - expected) / expected;
+
+    // mean size - 1 with standard deviation sqrt(2 (size - 1))
+    ASSERT_LE(chi2, size + 6 * std::sqrt(2.0 * size) + 10) << a << ' ' << b;
+}
+
+TEST(BoundedUniform, Uniform64) {
+    std::mt19937_64 gen(1);
+    check_uniform<uint64_t>(gen, 0, 0);
+    check_uniform<uint64_t>(gen, 0, 1);
+    check_uniform<uint64_t>(gen, 5, 11);
+    check_uniform<size_t>(gen, 0, 999);
+    check_uniform<int>(gen, -50, 50);
+    check_uniform<unsigned>(gen, 7, 7);
+}
+
+TEST(BoundedUniform, Uniform32) {
+    std::mt19937 gen(2);
+    check_uniform<uint64_t>(gen, 0, 1);
+    check_uniform<uint32_t>(gen, 3, 102);
+    check_uniform<int64_t>(gen, -300, 300);
+}
+
+TEST(BoundedUniform, Fallback) {
+    // neither 32 nor 64 bits; handled by std::uniform_int_distribution
+    std::minstd_rand gen(3);
+    check_uniform<unsigned>(gen, 0, 63);
+    check_uniform<uint64_t>(gen, 10, 20);
+}
+
+TEST(BoundedUniform, LargeRanges) {
+    std::mt19937_64 gen64(4);
+    std::mt19937 gen32(5);
+
+    // near the width of the generator, almost half of the words are rejected
+    constexpr auto kMax64 = std::numeric_limits<uint64_t>::max();
+    urns::BoundedUniform<uint64_t> half(0, kMax64 / 2 + 1);
+    urns::BoundedUniform<uint64_t> full;
+    urns::BoundedUniform<uint64_t> wide32(0, uint64_t{1} << 40);
+
+    unsigned upper_half = 0;
+    for(unsigned i = 0; i < 100000; ++i) {
+        const auto x = half(gen64);
+        ASSERT_LE(x, kMax64 / 2 + 1);
+        upper_half += (x > kMax64 / 4);
+        full(gen64);
+        ASSERT_LE(wide32(gen32), uint64_t{1} << 40);
+    }
+    ASSERT_NEAR(upper_half, 50000, 1000);
+
+    // the extreme ends of a full range of a signed type
+    urns::BoundedUniform<int64_t> signed_full(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max());
+    unsigned negative = 0;
+    for(unsigned i = 0; i < 10000; ++i)
+        negative += (signed_full(gen64) < 0);
+    ASSERT_NEAR(negative, 5000, 300);
+}
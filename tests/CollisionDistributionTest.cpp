@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <pps/CollisionDistribution.hpp>
+#include <pps/LogGamma.hpp>
+#include <pps/TabulatedCollisionDistribution.hpp>
+
+TEST(LogGamma, MatchesStd) {
+    std::mt19937_64 gen(1);
+    std::uniform_real_distribution<double> distr_exp(0.0, 40.0);
+
+    for(unsigned i = 0; i < 100000; ++i) {
+        const auto x = std::exp(distr_exp(gen));
+        ASSERT_NEAR(pps::log_gamma::log(x), std::log(x), 1e-14 * std::max(1.0, std::abs(std::log(x)))) << x;
+        ASSERT_NEAR(pps::log_gamma::lgamma(x), std::lgamma(x), 1e-11 * std::max(1.0, std::abs(std::lgamma(x)))) << x;
+    }
+
+    // integers as used by CollisionDisitribution
+    for(double x : {1.0, 2.0, 3.0, 10.0, 1e6, 1e9, 1e12})
+        ASSERT_NEAR(pps::log_gamma::lgamma(x), std::lgamma(x), 1e-11 * std::max(1.0, std::lgamma(x))) << x;
+}
+
+TEST(CollisionDistribution, Tail) {
+    std::mt19937_64 gen(2);
+
+    for(long long n : {1000ll, 100000ll, 10000000ll}) {
+        const long long max_g = 16 * static_cast<long long>(std::sqrt(n));
+        pps::CollisionDisitribution distr(n, 0, max_g);
+
+        // visit the stages out of order, as they are built on first use
+        for(long long g : {max_g / 2, 0ll, max_g - 1, max_g / 16, max_g / 3}) {
+            distr.set_red(g);
+
+            constexpr unsigned kSamples = 20000;
+            std::vector<long long> samples(kSamples);
+            for(auto& s : samples)
+                s = distr(gen);
+
+            // P(X >= k) = (n-g)! / (n-g-k)! / n^k
+            const auto n_green = n - g;
+            for(double quantile : {0.99, 0.9, 0.5, 0.1, 0.01}) {
+                // smallest k with P(X >= k) <= quantile
+                long long k = 0;
+                double log_tail = 0.0;
+                while(log_tail > std::log(quantile)) {
+                    ++k;
+                    log_tail = std::lgamma(n_green) - std::lgamma(n_green - k) - k * std::log(n);
+                }
+
+                const auto expected = std::exp(log_tail) * kSamples;
+                const auto observed = std::count_if(samples.cbegin(), samples.cend(), [&](auto s) { return s >= k; });
+                ASSERT_NEAR(observed, expected, 5 * std::sqrt(expected) + 1) << n << ' ' << g << ' ' << k;
+            }
+        }
+    }
+}
+
+TEST(TabulatedCollisionDistribution, MatchesReference) {
+    std::mt19937_64 gen(3);
+    std::uniform_real_distribution<double> unif(std::numeric_limits<double>::min(), 1.0);
+
+    for(long long n : {1000ll, 100000ll, 10000000ll}) {
+        const long long max_g = 16 * static_cast<long long>(std::sqrt(n));
+        pps::CollisionDisitribution reference(n, 0, max_g);
+        pps::TabulatedCollisionDistribution distr(n, 0, max_g);
+
+        for(long long g : {0ll, 1ll, max_g / 16, max_g / 2, max_g - 1}) {
+            reference.set_red(g);
+            distr.set_red(g);
+
+            // both invert the same CDF, but may round differently right at a step
+            unsigned mismatches = 0;
+            for(unsigned i = 0; i < 20000; ++i) {
+                const auto u = unif(gen);
+                const auto expected = reference.compute(u);
+                const auto actual = distr.compute(u);
+                ASSERT_LE(std::abs(expected - actual), 1) << n << ' ' << g << ' ' << u;
+                mismatches += (expected != actual);
+            }
+            ASSERT_LE(mismatches, 200u) << n << ' ' << g;
+        }
+    }
+}
+
+TEST(TabulatedCollisionDistribution, Fallback) {
+    std::mt19937_64 gen(4);
+    std::uniform_real_distribution<double> unif(std::numeric_limits<double>::min(), 1.0);
+
+    // the table covers at most n/2 green balls, so large g are answered by the reference
+    const long long n = 1000;
+    const long long max_g = 16 * 62;
+    pps::CollisionDisitribution reference(n, 0, max_g);
+    pps::TabulatedCollisionDistribution distr(n, 0, max_g);
+
+    for(long long g : {n / 2 - 1, n / 2 + 1, 900ll}) {
+        reference.set_red(g);
+        distr.set_red(g);
+        for(unsigned i = 0; i < 1000; ++i) {
+            const auto u = unif(gen);
+            ASSERT_LE(std::abs(reference.compute(u) - distr.compute(u)), 1) << g << ' ' << u;
+        }
+    }
+
+    ASSERT_GE(distr.num_fallbacks(), 2000u);
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <pps/CompiledProtocol.hpp>
+
+#include <protocols/clock_protocol.hpp>
+#include <protocols/increment_one_protocol.hpp>
+#include <protocols/leader_election_protocol.hpp>
+#include <protocols/majority_protocol.hpp>
+#include <protocols/random_protocol.hpp>
+
+template <typename Protocol>
+size_t compiled_entry_bytes(Protocol& protocol, pps::state_t num_states) {
+    // do not depend on the L2 size of the machine running the test
+    auto compiled = pps::Protocols::compile(protocol, num_states, 1llu << 24);
+
+    return std::visit([&] (auto& alternative) -> size_t {
+        using alt_type = std::decay_t<decltype(alternative)>;
+        if constexpr (std::is_same_v<alt_type, std::monostate>) {
+            return 0;
+        } else {
+            static_assert(pps::Protocols::is_deterministic<alt_type>);
+            static_assert(pps::Protocols::is_one_way<alt_type> == pps::Protocols::is_one_way<Protocol>);
+
+            for(pps::state_t first = 0; first < num_states; ++first) {
+                for(pps::state_t second = 0; second < num_states; ++second) {
+                    const auto expected = pps::Protocols::transition(protocol, {first, second});
+                    const auto actual = pps::Protocols::transition(alternative, {first, second});
+                    EXPECT_EQ(expected, actual) << first << " " << second;
+                }
+            }
+
+            return sizeof(typename alt_type::entry_type);
+        }
+    }, compiled);
+}
+
+TEST(CompiledProtocol, Clock) {
+    ClockProtocol prot(11);
+    ASSERT_EQ(compiled_entry_bytes(prot, prot.num_states()), 1u);
+}
+
+TEST(CompiledProtocol, Majority) {
+    MajorityProtocol prot;
+    ASSERT_EQ(compiled_entry_bytes(prot, prot.num_states()), 1u);
+}
+
+TEST(CompiledProtocol, LeaderElection) {
+    LeaderElectionProtocol prot;
+    ASSERT_EQ(compiled_entry_bytes(prot, prot.num_states()), 1u);
+}
+
+TEST(CompiledProtocol, Random) {
+    std::mt19937_64 gen(1);
+    for(pps::state_t num_states : {2, 17, 256, 257, 300}) {
+        RandomProtocolOneWay one_way(gen, num_states);
+        ASSERT_EQ(compiled_entry_bytes(one_way, num_states), num_states > 256 ? 2u : 1u);
+
+        RandomProtocolTwoWay two_way(gen, num_states);
+        ASSERT_EQ(compiled_entry_bytes(two_way, num_states), num_states > 256 ? 2u : 1u);
+    }
+}
+
+TEST(CompiledProtocol, OutOfRangeStates) {
+    // the resulting states of the last row exceed the number of states
+    IncrementOneProtocol<IncrementOneStrategy::TwoWayBoth> prot;
+    ASSERT_EQ(compiled_entry_bytes(prot, 255), 1u);
+    ASSERT_EQ(compiled_entry_bytes(prot, 256), 2u);
+}
+
+TEST(CompiledProtocol, SizeLimit) {
+    MajorityProtocol prot;
+    auto compiled = pps::Protocols::compile(prot, prot.num_states(), 16);
+    ASSERT_TRUE(std::holds_alternative<std::monostate>(compiled));
+}
@@ -0,0 +1,128 @@
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <sampling/fast_hypergeometric_distribution.hpp>
+#include <sampling/multivariate_hypergeometric.hpp>
+
+static double hypergeometric_log_pmf(long long good, long long bad, long long sample, long long k) {
+    auto log_binom = [](long long n, long long k) {
+        return std::lgamma(n + 1.0) - std::lgamma(k + 1.0) - std::lgamma(n - k + 1.0);
+    };
+    return log_binom(good, k) + log_binom(bad, sample - k) - log_binom(good + bad, sample);
+}
+
+TEST(Hypergeometric, LogFactorial) {
+    for(long long k : {0ll, 1ll, 2ll, 10ll, 1023ll, 1024ll, 1025ll, 100000ll, 1000000000ll, 1000000000000ll})
+        ASSERT_NEAR(sampling::log_factorial::get(k), std::lgamma(k + 1.0), 1e-14 * std::max(1.0, std::lgamma(k + 1.0))) << k;
+}
+
+TEST(Hypergeometric, MatchesPmf) {
+    std::mt19937_64 gen(1);
+    sampling::fast_hypergeometric_distribution<std::mt19937_64> distr(gen);
+
+    // covers inversion (small means), rejection, the reference (large modes), and all symmetries
+    const long long params[][3] = {
+        {1, 10, 5}, {5, 5, 3}, {40, 60, 1}, {10, 90, 50}, {30, 70, 60}, {100, 100, 100},
+        {400, 600, 999}, {1000, 9000, 50}, {7000, 3000, 400}, {1000, 9000, 5000},
+        {3, 1000000, 500000}, {20, 1000000, 999000}, {100000, 900000, 300000}};
+
+    for(const auto& p : params) {
+        const auto good = p[0], bad = p[1], sample = p[2];
+
+        constexpr unsigned kSamples = 100000;
+        std::map<long long, unsigned> counts;
+        for(unsigned i = 0; i < kSamples; ++i) {
+            const auto x = distr(good, bad, sample);
+            ASSERT_GE(x, std::max(0ll, sample - bad));
+            ASSERT_LE(x, std::min(good, sample));
+            counts[x]++;
+        }
+
+        // every value with a large expectation is within 5 standard deviations
+        for(long long k = std::max(0ll, sample - bad); k <= std::min(good, sample); ++k) {
+            const auto expected = kSamples * std::exp(hypergeometric_log_pmf(good, bad, sample, k));
+            if (expected < 10)
+                continue;
+            ASSERT_NEAR(counts[k], expected, 5 * std::sqrt(expected)) << good << ' ' << bad << ' ' << sample << ' ' << k;
+        }
+    }
+}
+
+TEST(Hypergeometric, BinomialApproximation) {
+    std::mt19937_64 gen(2);
+    sampling::fast_hypergeometric_distribution<std::mt19937_64> distr(gen, 0.01);
+
+    // (sample - 1) / (good + bad - 1) < 0.01, so the binomial is used; both means agree
+    const long long good = 300000, bad = 700000, sample = 5000;
+    constexpr unsigned kSamples = 100000;
+
+    double sum = 0, sum2 = 0;
+    for(unsigned i = 0; i < kSamples; ++i) {
+        const auto x = static_cast<double>(distr(good, bad, sample));
+        sum += x;
+        sum2 += x * x;
+    }
+
+    const double p = 0.3;
+    const auto mean = sum / kSamples;
+    const auto variance = sum2 / kSamples - mean * mean;
+    ASSERT_NEAR(mean, sample * p, 5 * std::sqrt(sample * p * (1 - p) / kSamples));
+    ASSERT_NEAR(variance, sample * p * (1 - p), 0.05 * sample * p * (1 - p));
+}
+
+TEST(MultivariateHypergeometric, SplitMatchesPmf) {
+    std::mt19937_64 gen(3);
+    sampling::multivariate_hypergeometric<std::mt19937_64> mvh(gen);
+
+    // the first ones take the Bernoulli fast path via the cell, the rest, or the sample
+    const long long params[][3] = {
+        {1, 99, 50}, {3, 97, 50}, {4, 6, 5}, {60, 2, 30}, {50, 50, 3}, {5, 5, 8}, {30, 70, 60}};
+
+    for(const auto& p : params) {
+        const auto count = p[0], rest = p[1], sample = p[2];
+
+        constexpr unsigned kSamples = 100000;
+        std::map<long long, unsigned> counts;
+        for(unsigned i = 0; i < kSamples; ++i)
+            counts[mvh.split(count, rest, sample)]++;
+
+        for(long long k = std::max(0ll, sample - rest); k <= std::min(count, sample); ++k) {
+            const auto expected = kSamples * std::exp(hypergeometric_log_pmf(count, rest, sample, k));
+            ASSERT_NEAR(counts[k], expected, 5 * std::sqrt(expected) + 1) << count << ' ' << rest << ' ' << sample << ' ' << k;
+        }
+    }
+}
+
+TEST(MultivariateHypergeometric, Span) {
+    std::mt19937_64 gen(4);
+    sampling::multivariate_hypergeometric<std::mt19937_64> mvh(gen);
+
+    const std::vector<int64_t> counts{0, 1, 1000, 3, 0, 50000, 2, 700, 0, 12345};
+    const auto total = std::accumulate(counts.cbegin(), counts.cend(), int64_t{0});
+    const int64_t sample = 20000;
+
+    constexpr unsigned kSamples = 20000;
+    std::vector<double> sums(counts.size(), 0.0);
+    std::vector<int64_t> out(counts.size());
+
+    for(unsigned i = 0; i < kSamples; ++i) {
+        mvh(counts.data(), counts.size(), sample, out.data());
+        ASSERT_EQ(std::accumulate(out.cbegin(), out.cend(), int64_t{0}), sample);
+        for(size_t c = 0; c < counts.size(); ++c) {
+            ASSERT_LE(out[c], counts[c]);
+            sums[c] += out[c];
+        }
+    }
+
+    // every marginal is hypergeometric
+    for(size_t c = 0; c < counts.size(); ++c) {
+        const auto p = static_cast<double>(counts[c]) / total;
+        const auto mean = sample * p;
+        const auto variance = mean * (1 - p) * (total - sample) / (total - 1);
+        ASSERT_NEAR(sums[c] / kSamples, mean, 5 * std::sqrt(variance / kSamples) + 1e-9) << c;
+    }
+}
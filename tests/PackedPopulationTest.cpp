@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <pps/AsyncPopulationSimulator.hpp>
+#include <pps/PackedPopulation.hpp>
+
+#include <protocols/leader_election_protocol.hpp>
+#include <protocols/majority_protocol.hpp>
+#include <protocols/random_protocol.hpp>
+
+template <typename T>
+class PackedPopulationTest : public ::testing::Test {};
+
+using MyPopulations = ::testing::Types<
+    pps::PackedPopulation<1>,
+    pps::PackedPopulation<2>,
+    pps::PackedPopulation<4>,
+    pps::PackedPopulation<8>,
+    pps::PackedPopulation<16>,
+    pps::PackedPopulation<32>
+>;
+TYPED_TEST_CASE(PackedPopulationTest, MyPopulations);
+
+TYPED_TEST(PackedPopulationTest, SetGet) {
+    std::mt19937_64 gen(1);
+    const size_t num_states = std::min<uint64_t>(1llu << TypeParam::kBits, 1000);
+    std::uniform_int_distribution<pps::state_t> distr_state(0, num_states - 1);
+
+    for(size_t size : {1, 63, 64, 65, 1000}) {
+        TypeParam population(size);
+        std::vector<pps::state_t> reference(size, 0);
+        std::uniform_int_distribution<size_t> distr_index(0, size - 1);
+
+        for(size_t i = 0; i < 10 * size; ++i) {
+            const auto index = distr_index(gen);
+            const auto state = distr_state(gen);
+            population.set(index, state);
+            reference[index] = state;
+        }
+
+        for(size_t i = 0; i < size; ++i)
+            ASSERT_EQ(population[i], reference[i]) << size << " " << i;
+    }
+}
+
+TEST(PackedPopulation, BitsPerState) {
+    ASSERT_EQ(pps::bits_per_state(2), 1u);
+    ASSERT_EQ(pps::bits_per_state(3), 2u);
+    ASSERT_EQ(pps::bits_per_state(4), 2u);
+    ASSERT_EQ(pps::bits_per_state(5), 4u);
+    ASSERT_EQ(pps::bits_per_state(256), 8u);
+    ASSERT_EQ(pps::bits_per_state(257), 16u);
+    ASSERT_EQ(pps::bits_per_state(1u << 16), 16u);
+    ASSERT_EQ(pps::bits_per_state((1u << 16) + 1), 32u);
+}
+
+template <unsigned Bits, typename Protocol>
+void run_and_count(Protocol prot, pps::WeightedUrn urn) {
+    std::mt19937_64 gen(Bits);
+    const auto num_agents = urn.number_of_balls();
+    pps::AsyncPopulationSimulator<4, Protocol, std::mt19937_64, Bits> sim(urn, prot, gen);
+
+    ASSERT_EQ(sim.population().memory_bytes(), (num_agents * Bits + 7) / 8);
+    ASSERT_EQ(sim.agents(), urn);
+
+    sim.run([&] (const auto& s) { return s.num_interactions() < 20 * num_agents; });
+    ASSERT_EQ(sim.agents().number_of_balls(), num_agents);
+}
+
+TEST(PackedPopulation, LeaderElection) {
+    LeaderElectionProtocol prot;
+    pps::WeightedUrn urn(prot.num_states());
+    urn.add_balls(LeaderElectionProtocol::Leader, 6400);
+    run_and_count<1>(prot, urn);
+}
+
+TEST(PackedPopulation, Majority) {
+    MajorityProtocol prot;
+    pps::WeightedUrn urn(prot.num_states());
+    urn.add_balls(prot.encode({false, true}), 3200);
+    urn.add_balls(prot.encode({true, true}), 3200);
+    run_and_count<2>(prot, urn);
+}
+
+// the parallel engine carries out the same interactions as the sequential one
+template <unsigned Bits, typename Protocol>
+void compare_parallel(Protocol prot, size_t num_agents) {
+    pps::WeightedUrn urn(prot.num_states());
+    for (pps::state_t s = 0; s < prot.num_states(); ++s)
+        urn.add_balls(s, num_agents / prot.num_states());
+
+    auto simulate = [&](unsigned num_threads) {
+        std::mt19937_64 gen(Bits);
+        pps::AsyncPopulationSimulator<4, Protocol, std::mt19937_64, Bits> sim(urn, prot, gen, num_threads);
+        sim.run([](const auto& s) { return s.num_epochs() < 50; });
+        return sim;
+    };
+
+    const auto sequential = simulate(1);
+    const auto parallel = simulate(4);
+
+    ASSERT_EQ(sequential.num_interactions(), parallel.num_interactions());
+    for (size_t i = 0; i < sequential.population().size(); ++i)
+        ASSERT_EQ(sequential.population()[i], parallel.population()[i]) << i;
+}
+
+TEST(PackedPopulation, ParallelMatchesSequential) {
+    std::mt19937_64 gen(1);
+    compare_parallel<1>(RandomProtocolTwoWay(gen, 2), 1 << 20);
+    compare_parallel<2>(RandomProtocolOneWay(gen, 3), 1 << 20);
+    compare_parallel<4>(RandomProtocolTwoWay(gen, 16), 1 << 20);
+    compare_parallel<8>(RandomProtocolTwoWay(gen, 200), 1 << 20);
+    compare_parallel<32>(RandomProtocolOneWay(gen, 1000), 1 << 20);
+}
+
+// vectorized kernels (if enabled) carry out the same interactions as the scalar code
+template <unsigned Bits, typename Protocol>
+void compare_prefetched(Protocol prot, size_t num_agents) {
+    pps::WeightedUrn urn(prot.num_states());
+    for (pps::state_t s = 0; s < prot.num_states(); ++s)
+        urn.add_balls(s, num_agents / prot.num_states());
+
+    std::mt19937_64 gen_scalar(3);
+    pps::AsyncPopulationSimulator<0, Protocol, std::mt19937_64, Bits> scalar(urn, prot, gen_scalar);
+    scalar.run([](const auto& s) { return s.num_epochs() < 100; });
+
+    std::mt19937_64 gen_prefetched(3);
+    pps::AsyncPopulationSimulator<4, Protocol, std::mt19937_64, Bits> prefetched(urn, prot,
+                                                                                gen_prefetched);
+    prefetched.run([&](const auto& s) { return s.num_interactions() < scalar.num_interactions(); });
+
+    ASSERT_EQ(scalar.num_interactions(), prefetched.num_interactions());
+    for (size_t i = 0; i < scalar.population().size(); ++i)
+        ASSERT_EQ(scalar.population()[i], prefetched.population()[i]) << i;
+}
+
+TEST(PackedPopulation, PrefetchedMatchesScalar) {
+    std::mt19937_64 gen(3);
+    // few agents provoke many conflicts within vectorized groups
+    compare_prefetched<32>(RandomProtocolTwoWay(gen, 5), 100);
+    compare_prefetched<32>(RandomProtocolOneWay(gen, 5), 100);
+    compare_prefetched<32>(RandomProtocolTwoWay(gen, 200), 1 << 16);
+    compare_prefetched<32>(RandomProtocolOneWay(gen, 300), 1 << 16);
+    compare_prefetched<32>(RandomProtocolTwoWay(gen, 1000), 1 << 16);
+
+    // narrow states share the 32 bit words read by the vectorized kernel
+    compare_prefetched<8>(RandomProtocolTwoWay(gen, 5), 100);
+    compare_prefetched<8>(RandomProtocolOneWay(gen, 5), 100);
+    compare_prefetched<8>(RandomProtocolTwoWay(gen, 200), 1 << 16);
+    compare_prefetched<16>(RandomProtocolOneWay(gen, 300), 1 << 16);
+    compare_prefetched<16>(RandomProtocolTwoWay(gen, 1000), 1 << 16);
+}
@@ -1,7 +1,12 @@
 #include <algorithm>
 #include <gtest/gtest.h>
 
+#include <urns/AdaptiveUrn.hpp>
+#include <urns/AliasUrnSimple.hpp>
+#include <urns/BAryTreeUrn.hpp>
+#include <urns/BucketUrn.hpp>
 #include <urns/LinearUrn.hpp>
+#include <urns/SelfOrganizingUrn.hpp>
 #include <urns/TreeUrn.hpp>
 
 #include <pps/AsyncBatchSimulator.hpp>
@@ -13,8 +18,8 @@
 template <typename Protocol>
 class SimulatorNoLossesTest : public ::testing::Test {};
 
-template <typename Protocol, typename Simulator>
-void count_interactions(size_t num_agents, size_t num_states, std::mt19937_64& gen) {
+template <typename Protocol, typename Simulator, typename... SimArgs>
+void count_interactions(size_t num_agents, size_t num_states, std::mt19937_64& gen, SimArgs... sim_args) {
     const auto max_states = static_cast<pps::state_t>(0.9 * num_states);
     using urn_type = typename Simulator::urn_type;
 
@@ -22,7 +27,7 @@ void count_interactions(size_t num_agents, size_t num_states, std::mt19937_64& g
     initial_urn.add_balls(0, num_agents);
 
     constexpr auto updates_per_interaction = Protocol::kIncreasePerInteraction;
-    Simulator simulator(std::move(initial_urn), Protocol{}, gen);
+    Simulator simulator(std::move(initial_urn), Protocol{}, gen, sim_args...);
 
     size_t num_interactions{0};
     pps::state_t max_used_state{0};
@@ -78,16 +83,61 @@ TYPED_TEST(SimulatorNoLossesTest, BatchSim) {
     count_interactions<TypeParam, pps::AsyncBatchSimulator<TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
 }
 
+TYPED_TEST(SimulatorNoLossesTest, BatchSimParallel) {
+    std::mt19937_64 gen(70 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncBatchSimulator<TypeParam, std::mt19937_64>>(10 * kNumAgents, kNumRounds, gen, 4u);
+}
+
+TYPED_TEST(SimulatorNoLossesTest, BatchSimPipelined) {
+    std::mt19937_64 gen(80 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncBatchSimulator<TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen, 1u, true);
+}
+
 TYPED_TEST(SimulatorNoLossesTest, DistrSimLinear) {
     std::mt19937_64 gen(20 + static_cast<unsigned>(TypeParam::kStrategy));
     count_interactions<TypeParam, pps::AsyncDistributionSimulator<urns::LinearUrn, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
 }
 
+TYPED_TEST(SimulatorNoLossesTest, DistrSimSelfOrganizing) {
+    std::mt19937_64 gen(150 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncDistributionSimulator<urns::SelfOrganizingUrn, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
+}
+
 TYPED_TEST(SimulatorNoLossesTest, DistrSimTree) {
     std::mt19937_64 gen(30 + static_cast<unsigned>(TypeParam::kStrategy));
     count_interactions<TypeParam, pps::AsyncDistributionSimulator<urns::TreeUrn, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
 }
 
+TYPED_TEST(SimulatorNoLossesTest, DistrSimAlias) {
+    std::mt19937_64 gen(180 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncDistributionSimulator<urns::AliasUrnSimple, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
+}
+
+TYPED_TEST(SimulatorNoLossesTest, DistrSimBAryTree) {
+    std::mt19937_64 gen(120 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncDistributionSimulator<urns::BAryTreeUrn<uint32_t>, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
+}
+
+TYPED_TEST(SimulatorNoLossesTest, DistrSimBucket) {
+    std::mt19937_64 gen(140 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncDistributionSimulator<urns::BucketUrn, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
+}
+
+TYPED_TEST(SimulatorNoLossesTest, DistrSimAdaptive) {
+    std::mt19937_64 gen(160 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncDistributionSimulator<urns::AdaptiveUrn, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
+}
+
+TYPED_TEST(SimulatorNoLossesTest, BatchSimAdaptive) {
+    std::mt19937_64 gen(170 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncBatchSimulator<TypeParam, std::mt19937_64, urns::AdaptiveUrn>>(kNumAgents, kNumRounds, gen);
+}
+
+TYPED_TEST(SimulatorNoLossesTest, BatchSimBAryTree) {
+    std::mt19937_64 gen(130 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncBatchSimulator<TypeParam, std::mt19937_64, urns::BAryTreeUrn<uint32_t>>>(kNumAgents, kNumRounds, gen);
+}
+
 TYPED_TEST(SimulatorNoLossesTest, PopSimPrefetch0) {
     std::mt19937_64 gen(40 + static_cast<unsigned>(TypeParam::kStrategy));
     count_interactions<TypeParam, pps::AsyncPopulationSimulator<0, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
@@ -102,3 +152,13 @@ TYPED_TEST(SimulatorNoLossesTest, PopSimPrefetch10) {
     std::mt19937_64 gen(60 + static_cast<unsigned>(TypeParam::kStrategy));
     count_interactions<TypeParam, pps::AsyncPopulationSimulator<10, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
 }
+
+TYPED_TEST(SimulatorNoLossesTest, PopSimPrefetchAdaptive) {
+    std::mt19937_64 gen(100 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncPopulationSimulator<pps::kAdaptivePrefetch, TypeParam, std::mt19937_64>>(kNumAgents, kNumRounds, gen);
+}
+
+TYPED_TEST(SimulatorNoLossesTest, PopSimPacked) {
+    std::mt19937_64 gen(90 + static_cast<unsigned>(TypeParam::kStrategy));
+    count_interactions<TypeParam, pps::AsyncPopulationSimulator<4, TypeParam, std::mt19937_64, pps::bits_per_state(kNumRounds)>>(kNumAgents, kNumRounds, gen);
+}
@@ -1,8 +1,12 @@
 #include <algorithm>
 #include <gtest/gtest.h>
 
+#include <urns/AdaptiveUrn.hpp>
 #include <urns/AliasUrnSimple.hpp>
+#include <urns/BAryTreeUrn.hpp>
+#include <urns/BucketUrn.hpp>
 #include <urns/LinearUrn.hpp>
+#include <urns/SelfOrganizingUrn.hpp>
 #include <urns/TreeUrn.hpp>
 #include <pps/WeightedUrn.hpp>
 
@@ -34,9 +38,14 @@ protected:
 };
 
 using MyUrns = ::testing::Types<
+    urns::AdaptiveUrn,
     urns::TreeUrn,
+    urns::BAryTreeUrn<uint32_t>,
+    urns::BAryTreeUrn<uint64_t>,
     urns::AliasUrnSimple,
+    urns::BucketUrn,
     urns::LinearUrn,
+    urns::SelfOrganizingUrn,
     pps::WeightedUrn
 >;
 TYPED_TEST_CASE(UrnsTest, MyUrns);
@@ -176,6 +185,92 @@ TYPED_TEST(UrnsTest, RepeatedFillNum) {
     }
 }
 
+TYPED_TEST(UrnsTest, BatchedDrawsMatchSequential) {
+    if constexpr (urns::traits::has_batched_draws_v<TypeParam>) {
+        std::mt19937_64 gen(1);
+
+        for(unsigned int num_colors : {2u, 7u, 100u, 1000u}) {
+            TypeParam batched(num_colors);
+            TypeParam sequential(num_colors);
+            this->random_fill_urn(batched, gen);
+            for(unsigned c = 0; c < num_colors; ++c)
+                sequential.add_balls(c, batched.number_of_balls_with_color(c));
+
+            // batches of several sizes until the urn is empty
+            std::vector<typename TypeParam::color_type> colors(2 * TypeParam::kBatchedDraws + 3);
+            for(size_t round = 0; !batched.empty(); ++round) {
+                const size_t num = std::min<size_t>(round % colors.size() + 1, batched.number_of_balls());
+
+                auto gen_seq = gen;
+                batched.remove_random_balls(gen, colors.data(), num);
+                for(size_t i = 0; i < num; ++i)
+                    ASSERT_EQ(colors[i], sequential.remove_random_ball(gen_seq)) << num_colors << ' ' << i;
+
+                ASSERT_EQ(batched.number_of_balls(), sequential.number_of_balls());
+                for(unsigned c = 0; c < num_colors; ++c)
+                    ASSERT_EQ(batched.number_of_balls_with_color(c), sequential.number_of_balls_with_color(c));
+
+                if (!batched.empty()) {
+                    auto gen_get = gen;
+                    batched.get_random_balls(gen, colors.data(), colors.size());
+                    for(auto c : colors)
+                        ASSERT_GT(batched.number_of_balls_with_color(c), 0);
+                    for(auto c : colors)
+                        ASSERT_EQ(c, sequential.get_random_ball(gen_get));
+                }
+            }
+        }
+    }
+}
+
+TYPED_TEST(UrnsTest, ReplaceRandomPair) {
+    if constexpr (urns::traits::has_pair_replacement_v<TypeParam>) {
+        std::mt19937_64 gen(2);
+
+        for(unsigned int num_colors : {2u, 7u, 100u}) {
+            TypeParam urn(num_colors);
+            size_t num_balls;
+            std::vector<size_t> nums_balls;
+            std::tie(num_balls, nums_balls) = this->random_fill_urn(urn, gen);
+            if (num_balls < 2) {
+                urn.add_balls(0, 2);
+                nums_balls[0] += 2;
+                num_balls += 2;
+            }
+
+            // shift the first ball's color; every fourth pair also moves the second ball
+            std::uniform_int_distribution<unsigned> distr_color(0, num_colors - 1);
+            for(unsigned round = 0; round < 10000; ++round) {
+                urn.replace_random_pair(gen, [&](auto first, auto second) {
+                    EXPECT_GT(nums_balls[first], 0u);
+                    EXPECT_GT(nums_balls[second], first == second ? 1u : 0u);
+                    nums_balls[first]--;
+                    nums_balls[second]--;
+
+                    const auto new_first = (first + 1) % num_colors;
+                    const auto new_second = (round % 4) ? second : distr_color(gen);
+                    nums_balls[new_first]++;
+                    nums_balls[new_second]++;
+
+                    return std::make_pair(new_first, new_second);
+                });
+
+                ASSERT_EQ(urn.number_of_balls(), num_balls);
+            }
+
+            for(unsigned c = 0; c < num_colors; ++c)
+                ASSERT_EQ(urn.number_of_balls_with_color(c), nums_balls[c]) << c;
+
+            // draining the urn checks the internal state
+            while(!urn.empty()) {
+                const auto col = urn.remove_random_ball(gen);
+                ASSERT_GT(nums_balls[col], 0u);
+                nums_balls[col]--;
+            }
+        }
+    }
+}
+
 TEST(TreeUrn, AddUrn) {
     std::uniform_int_distribution<unsigned> distr_num_colors(2, 100);
 
@@ -208,3 +303,498 @@ TEST(TreeUrn, AddUrn) {
         }
     }
 }
+
+template <typename T>
+class BAryTreeUrnTest : public ::testing::Test {};
+
+using MyBAryTreeUrns = ::testing::Types<urns::BAryTreeUrn<uint32_t>, urns::BAryTreeUrn<uint64_t>>;
+TYPED_TEST_CASE(BAryTreeUrnTest, MyBAryTreeUrns);
+
+TYPED_TEST(BAryTreeUrnTest, ManyColors) {
+    std::mt19937_64 gen(2);
+
+    // deep enough to have several partially filled levels
+    for(unsigned int num_colors : {1000u, 4097u, 5000u}) {
+        std::uniform_int_distribution<unsigned> distr_num_balls(0, 5);
+
+        urns::TreeUrn reference(num_colors);
+        std::vector<size_t> nums_balls(num_colors);
+        for(unsigned c = 0; c < num_colors; ++c) {
+            nums_balls[c] = distr_num_balls(gen);
+            reference.add_balls(c, nums_balls[c]);
+        }
+
+        // fill once via the tree construction and once by single insertions
+        TypeParam built(num_colors);
+        built.add_urn(reference);
+
+        TypeParam inserted(num_colors);
+        for(unsigned c = 0; c < num_colors; ++c)
+            inserted.add_balls(c, nums_balls[c]);
+
+        inserted.add_urn(built);
+        ASSERT_EQ(inserted.number_of_balls(), 2 * reference.number_of_balls());
+
+        auto remaining = nums_balls;
+        for(auto& x : remaining) x *= 2;
+
+        while(!inserted.empty()) {
+            const auto col = inserted.remove_random_ball(gen);
+            ASSERT_LT(col, num_colors);
+            ASSERT_GT(remaining[col], 0u);
+            remaining[col]--;
+            ASSERT_EQ(inserted.number_of_balls_with_color(col), remaining[col]);
+        }
+    }
+}
+
+template <typename T>
+class SamplingUrnsTest : public UrnsTest<T> {};
+
+using MySamplingUrns = ::testing::Types<urns::AdaptiveUrn, urns::TreeUrn, urns::BAryTreeUrn<uint64_t>, pps::WeightedUrn>;
+TYPED_TEST_CASE(SamplingUrnsTest, MySamplingUrns);
+
+TYPED_TEST(SamplingUrnsTest, SampleWithoutReplacement) {
+    std::mt19937_64 gen(3);
+
+    for(unsigned int num_colors : {2u, 7u, 100u, 1000u}) {
+        TypeParam urn(num_colors);
+        auto [num_balls, nums_balls] = this->random_fill_urn(urn, gen);
+
+        for(size_t num_samples : {size_t{1}, size_t{10}, num_balls / 2, num_balls}) {
+            // without empty colors
+            {
+                size_t total = 0;
+                size_t last_color = 0;
+                bool first = true;
+                urn.template sample_without_replacement<false>(num_samples, gen, [&](auto col, auto num) {
+                    ASSERT_TRUE(first || col > last_color);
+                    ASSERT_GT(num, 0);
+                    ASSERT_LE(num, nums_balls[col]);
+                    if (num_samples == num_balls) {
+                        ASSERT_EQ(num, nums_balls[col]);
+                    }
+                    first = false;
+                    last_color = col;
+                    total += num;
+                });
+                ASSERT_EQ(total, num_samples);
+            }
+
+            // with empty colors
+            {
+                size_t total = 0;
+                size_t next_color = 0;
+                urn.template sample_without_replacement<true>(num_samples, gen, [&](auto col, auto num) {
+                    ASSERT_EQ(col, next_color++);
+                    ASSERT_LE(num, nums_balls[col]);
+                    total += num;
+                });
+                ASSERT_EQ(total, num_samples);
+                ASSERT_EQ(next_color, num_colors);
+            }
+        }
+
+        ASSERT_EQ(urn.number_of_balls(), num_balls);
+    }
+}
+
+TYPED_TEST(SamplingUrnsTest, SampleMean) {
+    std::mt19937_64 gen(4);
+    constexpr unsigned kNumColors = 50;
+    constexpr size_t kNumSamples = 100;
+    constexpr size_t kRepeats = 2000;
+
+    TypeParam urn(kNumColors);
+    auto [num_balls, nums_balls] = this->random_fill_urn(urn, gen);
+
+    std::vector<size_t> sampled(kNumColors, 0);
+    for(size_t r = 0; r < kRepeats; ++r)
+        urn.template sample_without_replacement<false>(kNumSamples, gen, [&](auto col, auto num) { sampled[col] += num; });
+
+    for(unsigned c = 0; c < kNumColors; ++c) {
+        const double expected = static_cast<double>(kRepeats) * kNumSamples * nums_balls[c] / num_balls;
+        ASSERT_NEAR(sampled[c], expected, 5 * std::sqrt(expected) + 1) << c;
+    }
+}
+
+TYPED_TEST(SamplingUrnsTest, RemoveRandomBalls) {
+    std::mt19937_64 gen(5);
+
+    for(unsigned int num_colors : {2u, 7u, 100u, 1000u}) {
+        TypeParam urn(num_colors);
+        auto [num_balls, nums_balls] = this->random_fill_urn(urn, gen);
+
+        while(num_balls) {
+            const size_t num_samples = std::min<size_t>(num_balls, 1 + num_balls / 3);
+            urn.template remove_random_balls<false>(num_samples, gen, [&](auto col, auto num) {
+                ASSERT_LE(num, nums_balls[col]);
+                nums_balls[col] -= num;
+            });
+            num_balls -= num_samples;
+
+            ASSERT_EQ(urn.number_of_balls(), num_balls);
+            for(unsigned c = 0; c < num_colors; ++c)
+                ASSERT_EQ(urn.number_of_balls_with_color(c), nums_balls[c]);
+        }
+
+        ASSERT_TRUE(urn.empty());
+    }
+}
+
+template <typename T>
+class MergeableUrnsTest : public UrnsTest<T> {};
+
+using MyMergeableUrns = ::testing::Types<urns::AdaptiveUrn, urns::TreeUrn, urns::BAryTreeUrn<uint32_t>, urns::BAryTreeUrn<uint64_t>, pps::WeightedUrn>;
+TYPED_TEST_CASE(MergeableUrnsTest, MyMergeableUrns);
+
+TYPED_TEST(MergeableUrnsTest, AddUrnAndClear) {
+    std::mt19937_64 gen(6);
+    constexpr unsigned kNumColors = 1000;
+    std::uniform_int_distribution<unsigned> distr_color(0, kNumColors - 1);
+
+    TypeParam target(kNumColors);
+    auto [num_balls, nums_balls] = this->random_fill_urn(target, gen);
+
+    TypeParam updates(kNumColors);
+
+    // few touched colors take the sparse path, many the full sweep
+    for(unsigned num_touched : {1u, 5u, 30u, 200u, 5000u, 3u}) {
+        for(unsigned i = 0; i < num_touched; ++i) {
+            updates.add_balls(distr_color(gen), 2);
+
+            // removals must not break the bookkeeping either
+            updates.remove_random_ball(gen);
+        }
+
+        num_balls = target.number_of_balls() + updates.number_of_balls();
+        for(unsigned c = 0; c < kNumColors; ++c)
+            nums_balls[c] = target.number_of_balls_with_color(c) + updates.number_of_balls_with_color(c);
+
+        target.add_urn(updates);
+        updates.clear();
+
+        ASSERT_TRUE(updates.empty());
+        ASSERT_EQ(target.number_of_balls(), num_balls);
+        for(unsigned c = 0; c < kNumColors; ++c) {
+            ASSERT_EQ(target.number_of_balls_with_color(c), nums_balls[c]) << c;
+            ASSERT_EQ(updates.number_of_balls_with_color(c), 0u) << c;
+        }
+
+        // the cleared urn has to work as new
+        const auto col = distr_color(gen);
+        updates.add_balls(col, 3);
+        ASSERT_EQ(updates.get_random_ball(gen), col);
+        ASSERT_EQ(updates.remove_random_ball(gen), col);
+        updates.clear();
+        ASSERT_TRUE(updates.empty());
+    }
+
+    // draws from the merged urn only return existing colors
+    while(!target.empty()) {
+        const auto col = target.remove_random_ball(gen);
+        ASSERT_GT(nums_balls[col], 0u);
+        nums_balls[col]--;
+    }
+}
+
+template <typename T>
+class OccupiedUrnsTest : public UrnsTest<T> {
+protected:
+    template <typename Urn>
+    void check_occupied(const Urn& urn) {
+        std::vector<size_t> expected;
+        for(size_t c = 0; c < urn.number_of_colors(); ++c)
+            if (urn.number_of_balls_with_color(c))
+                expected.push_back(c);
+
+        const auto& occupied = urn.occupied_colors();
+        ASSERT_EQ(occupied.size(), expected.size());
+        ASSERT_TRUE(std::equal(occupied.begin(), occupied.end(), expected.begin(), expected.end()));
+    }
+};
+
+using MyOccupiedUrns = ::testing::Types<urns::TreeUrn, pps::WeightedUrn>;
+TYPED_TEST_CASE(OccupiedUrnsTest, MyOccupiedUrns);
+
+TYPED_TEST(OccupiedUrnsTest, FollowsUpdates) {
+    std::mt19937_64 gen(11);
+
+    for(unsigned int num_colors : {2u, 7u, 100u, 1000u}) {
+        std::uniform_int_distribution<unsigned> distr_color(0, num_colors - 1);
+
+        TypeParam urn(num_colors);
+        this->check_occupied(urn);
+
+        // few occupied colors
+        for(unsigned i = 0; i < 5; ++i)
+            urn.add_balls(distr_color(gen), 3);
+        this->check_occupied(urn);
+
+        this->random_fill_urn(urn, gen);
+        this->check_occupied(urn);
+
+        // single and batched draws empty some colors
+        const size_t num_single_draws = urn.number_of_balls() / 2;
+        for(size_t i = 0; i < num_single_draws; ++i)
+            urn.remove_random_ball(gen);
+        this->check_occupied(urn);
+
+        std::vector<typename TypeParam::color_type> colors(urn.number_of_balls() / 2);
+        urn.remove_random_balls(gen, colors.data(), colors.size());
+        this->check_occupied(urn);
+
+        // bulk removals, sparse and dense
+        for(auto num : {urn.number_of_balls() / 100, urn.number_of_balls() / 2}) {
+            size_t num_sampled = 0;
+            urn.template remove_random_balls<false>(num, gen, [&](auto, auto n) { num_sampled += n; });
+            ASSERT_EQ(num_sampled, num);
+            this->check_occupied(urn);
+        }
+
+        // merges
+        TypeParam other(num_colors);
+        other.add_balls(distr_color(gen), 4);
+        urn.add_urn(other);
+        this->check_occupied(urn);
+
+        this->random_fill_urn(other, gen);
+        urn.add_urn(other);
+        this->check_occupied(urn);
+
+        while(!urn.empty())
+            urn.remove_balls(*urn.occupied_colors().begin(), urn.number_of_balls_with_color(*urn.occupied_colors().begin()));
+        this->check_occupied(urn);
+
+        urn.add_balls(0, 2);
+        urn.clear();
+        this->check_occupied(urn);
+
+        // sparse clear only visits the touched colors
+        urn.add_balls(num_colors - 1, 1);
+        urn.add_balls(num_colors / 2, 3);
+        this->check_occupied(urn);
+        urn.clear();
+        this->check_occupied(urn);
+
+        urn.add_balls(distr_color(gen), 1);
+        this->check_occupied(urn);
+    }
+}
+
+TEST(BucketUrn, Distribution) {
+    std::mt19937_64 gen(7);
+
+    // weights spread over several groups, including ones at group boundaries
+    const std::vector<size_t> weights{1, 2, 3, 4, 7, 8, 100, 127, 128, 1000, 0, 5};
+    urns::BucketUrn urn(weights.size());
+    size_t num_balls = 0;
+    for(size_t c = 0; c < weights.size(); ++c) {
+        urn.add_balls(c, weights[c]);
+        num_balls += weights[c];
+    }
+
+    constexpr size_t kDraws = 1'000'000;
+    std::vector<size_t> drawn(weights.size(), 0);
+    for(size_t i = 0; i < kDraws; ++i)
+        drawn[urn.get_random_ball(gen)]++;
+
+    for(size_t c = 0; c < weights.size(); ++c) {
+        const double expected = static_cast<double>(kDraws) * weights[c] / num_balls;
+        ASSERT_NEAR(drawn[c], expected, 5 * std::sqrt(expected) + 1) << c;
+    }
+
+    // drain the urn and thereby move colors through all lower groups
+    auto remaining = weights;
+    while(!urn.empty()) {
+        const auto col = urn.remove_random_ball(gen);
+        ASSERT_GT(remaining[col], 0u);
+        remaining[col]--;
+        ASSERT_EQ(urn.number_of_balls_with_color(col), remaining[col]);
+        ASSERT_EQ(urn.number_of_balls(), --num_balls);
+    }
+}
+
+TEST(WeightedUrn, GuideTable) {
+    std::mt19937_64 gen(8);
+
+    // some empty colors and a few heavy ones
+    constexpr size_t kColors = 100;
+    pps::WeightedUrn source(kColors);
+    for(size_t c = 0; c < kColors; ++c)
+        source.add_balls(c, (c % 7 == 3) ? 0 : (c % 10 == 0 ? 1000 : c));
+
+    pps::WeightedUrn urn(kColors);
+    urn.enable_guide_table();
+    ASSERT_TRUE(urn.guide_table_enabled());
+    urn.add_urn(source);
+
+    auto remaining = std::vector<size_t>(source.data(), source.data() + kColors);
+    size_t num_balls = urn.number_of_balls();
+
+    auto remove = [&](size_t num) {
+        for(size_t i = 0; i < num; ++i) {
+            const auto col = urn.remove_random_ball(gen);
+            ASSERT_GT(remaining[col], 0u);
+            remaining[col]--;
+            ASSERT_EQ(urn.number_of_balls_with_color(col), remaining[col]);
+            ASSERT_EQ(urn.number_of_balls(), --num_balls);
+        }
+    };
+
+    // drawing from the table with rejections of removed balls
+    remove(num_balls / 3);
+
+    constexpr size_t kDraws = 1'000'000;
+    std::vector<size_t> drawn(kColors, 0);
+    for(size_t i = 0; i < kDraws; ++i)
+        drawn[urn.get_random_ball(gen)]++;
+
+    for(size_t c = 0; c < kColors; ++c) {
+        const double expected = static_cast<double>(kDraws) * remaining[c] / num_balls;
+        ASSERT_NEAR(drawn[c], expected, 5 * std::sqrt(expected) + 1) << c;
+    }
+
+    // insertions invalidate the table
+    urn.add_balls(1, 500);
+    remaining[1] += 500;
+    num_balls += 500;
+    remove(num_balls / 2);
+
+    // drain the urn, which rebuilds the table several times
+    urn.add_urn(pps::WeightedUrn(kColors));
+    remove(num_balls);
+    ASSERT_TRUE(urn.empty());
+}
+
+TEST(AdaptiveUrn, Migrates) {
+    using Representation = urns::AdaptiveUrn::Representation;
+    std::mt19937_64 gen(9);
+
+    constexpr size_t kColors = 1024;
+    urns::AdaptiveUrn urn(kColors);
+    std::vector<int64_t> nums_balls(kColors, 100);
+    for(size_t c = 0; c < kColors; ++c)
+        urn.add_balls(c, 100);
+    ASSERT_EQ(urn.representation(), Representation::Linear);
+
+    auto check_counts = [&] {
+        int64_t num_balls = 0;
+        for(size_t c = 0; c < kColors; ++c) {
+            ASSERT_EQ(urn.number_of_balls_with_color(c), nums_balls[c]) << c;
+            num_balls += nums_balls[c];
+        }
+        ASSERT_EQ(urn.number_of_balls(), num_balls);
+    };
+
+    auto interact = [&](size_t num, auto target_color) {
+        for(size_t i = 0; i < num; ++i) {
+            const auto col = urn.remove_random_ball(gen);
+            ASSERT_GT(nums_balls[col], 0);
+            nums_balls[col]--;
+
+            const auto target = target_color(col);
+            urn.add_balls(target);
+            nums_balls[target]++;
+        }
+    };
+
+    // many colors with single updates: linear scans are too expensive
+    std::uniform_int_distribution<size_t> distr_color(0, kColors - 1);
+    interact(100'000, [&](size_t) { return distr_color(gen); });
+    ASSERT_NE(urn.representation(), Representation::Linear);
+    check_counts();
+
+    // once (almost) all balls have the first color, the scan is shortest
+    interact(1'000'000, [](size_t) { return size_t{0}; });
+    ASSERT_GT(urn.number_of_balls_with_color(0), 99 * urn.number_of_balls() / 100);
+    ASSERT_EQ(urn.representation(), Representation::Linear);
+    check_counts();
+
+    // epochs that draw half of the balls and merge them back in bulk favour a table
+    urn.clear();
+    std::fill(nums_balls.begin(), nums_balls.end(), 100);
+    for(size_t c = 0; c < kColors; ++c)
+        urn.add_balls(c, 100);
+
+    urns::AdaptiveUrn removed(kColors);
+    for(size_t epoch = 0; epoch < 20; ++epoch) {
+        for(int64_t i = urn.number_of_balls() / 2; i; --i)
+            removed.add_balls(urn.remove_random_ball(gen));
+        urn.add_urn(removed);
+        removed.clear();
+    }
+    ASSERT_TRUE(urn.representation() == Representation::Guide ||
+                urn.representation() == Representation::Alias);
+    check_counts();
+}
+
+TEST(AdaptiveUrn, Representations) {
+    using Representation = urns::AdaptiveUrn::Representation;
+    std::mt19937_64 gen(10);
+
+    constexpr size_t kColors = 100;
+    for(auto representation : {Representation::Linear, Representation::Guide,
+                               Representation::Tree, Representation::Alias}) {
+        urns::AdaptiveUrn urn(kColors);
+        std::vector<int64_t> nums_balls(kColors, 0);
+        for(size_t c = 0; c < kColors; ++c) {
+            nums_balls[c] = c % 3 ? c : 0;
+            urn.add_balls(c, nums_balls[c]);
+        }
+
+        urn.convert_to(representation);
+        ASSERT_EQ(urn.representation(), representation);
+
+        auto check_counts = [&] {
+            int64_t num_balls = 0;
+            for(size_t c = 0; c < kColors; ++c) {
+                ASSERT_EQ(urn.number_of_balls_with_color(c), nums_balls[c]) << c;
+                num_balls += nums_balls[c];
+            }
+            ASSERT_EQ(urn.number_of_balls(), num_balls);
+        };
+
+        // single draws and updates (fewer than a window, so we stay put)
+        for(size_t i = 0; i < 1000; ++i) {
+            const auto col = urn.remove_random_ball(gen);
+            ASSERT_GT(nums_balls[col], 0);
+            nums_balls[col]--;
+
+            if (i % 2) {
+                urn.add_balls(col / 2);
+                nums_balls[col / 2]++;
+            }
+
+            const auto drawn = urn.get_random_ball(gen);
+            ASSERT_GT(nums_balls[drawn], 0);
+        }
+        check_counts();
+
+        // bulk operations
+        urns::AdaptiveUrn removed(kColors);
+        urn.remove_random_balls<false>(urn.number_of_balls() / 3, gen, [&](size_t col, int64_t num) {
+            nums_balls[col] -= num;
+            removed.add_balls(col, num);
+        });
+        check_counts();
+
+        urn.add_urn(removed);
+        for(size_t c = 0; c < kColors; ++c)
+            nums_balls[c] += removed.number_of_balls_with_color(c);
+        check_counts();
+        ASSERT_EQ(urn.representation(), representation);
+
+        while(!urn.empty()) {
+            const auto col = urn.remove_random_ball(gen);
+            ASSERT_GT(nums_balls[col], 0);
+            nums_balls[col]--;
+        }
+        check_counts();
+
+        urn.add_balls(3, 5);
+        urn.clear();
+        ASSERT_TRUE(urn.empty());
+        ASSERT_EQ(urn.number_of_balls_with_color(3), 0);
+    }
+}